@@ -0,0 +1,96 @@
+//! Throughput versus drain latency across stream batching options.
+//!
+//! For each combination of request size and linger time, one producer pushes
+//! fixed-size batches as fast as it can, then the stream is shut down and the
+//! time from the last push until every point has left the stream is measured.
+//! Larger requests raise throughput; shorter lingers cut the drain latency.
+//!
+//! Streams go to a file by default. Set `NOMINAL_TOKEN` and
+//! `NOMINAL_BENCH_RID` to stream to an ingest endpoint instead.
+//! Run with `cargo bench --bench batching`.
+
+use nominal_labview_ffi::{
+    nominal_create_channel, nominal_init_ex, nominal_push_double_batch, nominal_shutdown_ex,
+    NominalShutdownReport, NominalStreamOptions,
+};
+use std::ffi::CString;
+use std::time::{Duration, Instant};
+
+const BATCH: usize = 100;
+const RUN_TIME: Duration = Duration::from_secs(1);
+const POINTS_PER_REQUEST: [u64; 3] = [1_000, 10_000, 100_000];
+const LINGER_MS: [u64; 3] = [1, 10, 100];
+
+struct Sample {
+    points_per_second: f64,
+    drain: Duration,
+}
+
+fn run(rid: &CString, path: &CString, points_per_request: u64, linger_ms: u64) -> Sample {
+    let options = NominalStreamOptions {
+        struct_size: std::mem::size_of::<NominalStreamOptions>() as u64,
+        max_points_per_request: points_per_request,
+        max_linger_ms: linger_ms,
+        ..Default::default()
+    };
+
+    let name = CString::new("bench").unwrap();
+    let mut stream = 0u64;
+    let mut writer = 0u64;
+    unsafe {
+        assert_eq!(
+            nominal_init_ex(std::ptr::null(), rid.as_ptr(), path.as_ptr(), &options, &mut stream),
+            0
+        );
+        assert_eq!(nominal_create_channel(stream, name.as_ptr(), std::ptr::null(), &mut writer), 0);
+    }
+
+    let mut timestamps: Vec<u64> = (0..BATCH as u64).collect();
+    let values: Vec<f64> = (0..BATCH).map(|v| v as f64).collect();
+
+    let start = Instant::now();
+    let mut pushed = 0u64;
+    while start.elapsed() < RUN_TIME {
+        unsafe { assert_eq!(nominal_push_double_batch(writer, timestamps.as_ptr(), values.as_ptr(), BATCH), 0) };
+        pushed += BATCH as u64;
+        for t in &mut timestamps {
+            *t += BATCH as u64;
+        }
+    }
+    let elapsed = start.elapsed();
+
+    let drain_start = Instant::now();
+    let mut report = NominalShutdownReport::default();
+    unsafe { assert_eq!(nominal_shutdown_ex(stream, 60_000, &mut report), 0) };
+    let drain = drain_start.elapsed();
+    assert_eq!(report.points_sent, pushed);
+
+    Sample {
+        points_per_second: pushed as f64 / elapsed.as_secs_f64(),
+        drain,
+    }
+}
+
+fn main() {
+    let dir = std::env::temp_dir().join("nominal_ffi_batching");
+    std::fs::create_dir_all(&dir).unwrap();
+    let path = CString::new(dir.join("bench.avro").to_str().unwrap()).unwrap();
+    let rid = std::env::var("NOMINAL_BENCH_RID").unwrap_or_else(|_| "ri.catalog.main.dataset.bench".to_string());
+    let rid = CString::new(rid).unwrap();
+
+    println!("{:>18} {:>10} {:>16} {:>12}", "points/request", "linger ms", "points/s", "drain ms");
+    for points_per_request in POINTS_PER_REQUEST {
+        for linger_ms in LINGER_MS {
+            let sample = run(&rid, &path, points_per_request, linger_ms);
+            println!(
+                "{:>18} {:>10} {:>16.0} {:>12.1}",
+                points_per_request,
+                linger_ms,
+                sample.points_per_second,
+                sample.drain.as_secs_f64() * 1000.0
+            );
+        }
+    }
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
@@ -0,0 +1,160 @@
+//! Criterion micro-benchmarks for the FFI hot path.
+//!
+//! * `nominal_push_double_batch` at batch sizes from 1 to 1M points
+//! * `nominal_create_channel` with and without tags
+//! * `parse_tags_csv`
+//! * handle table lookups with 1 to 16 threads looking up the same handles
+//!
+//! Streams are file-only, in a directory under the system temp dir. Run with
+//! `cargo bench --bench ffi`; Criterion compares each run against the last.
+
+use criterion::{black_box, criterion_group, criterion_main, BenchmarkId, Criterion, Throughput};
+use nominal_labview_ffi::registry::HandleTable;
+use nominal_labview_ffi::{
+    nominal_close_channel, nominal_create_channel, nominal_init, nominal_push_double_batch,
+    nominal_shutdown, parse_tags_csv,
+};
+use std::ffi::CString;
+use std::path::PathBuf;
+use std::sync::{Arc, Barrier};
+use std::time::{Duration, Instant};
+
+const BATCH_SIZES: [usize; 7] = [1, 10, 100, 1_000, 10_000, 100_000, 1_000_000];
+const LOOKUP_THREADS: [usize; 3] = [1, 4, 16];
+const LOOKUP_HANDLES: usize = 1024;
+
+/// File-only stream in its own temp directory, removed on drop
+struct FileStream {
+    handle: u64,
+    dir: PathBuf,
+}
+
+impl FileStream {
+    fn new(name: &str) -> Self {
+        let dir = std::env::temp_dir().join(format!("nominal_ffi_criterion_{}", name));
+        std::fs::create_dir_all(&dir).unwrap();
+        let path = CString::new(dir.join("bench.avro").to_str().unwrap()).unwrap();
+        let rid = CString::new("ri.catalog.main.dataset.bench").unwrap();
+        let mut handle = 0u64;
+        unsafe {
+            assert_eq!(nominal_init(std::ptr::null(), rid.as_ptr(), path.as_ptr(), &mut handle), 0);
+        }
+        Self { handle, dir }
+    }
+
+    fn channel(&self, name: &str, tags_csv: Option<&str>) -> u64 {
+        let name = CString::new(name).unwrap();
+        let tags = tags_csv.map(|t| CString::new(t).unwrap());
+        let tags_ptr = tags.as_ref().map_or(std::ptr::null(), |t| t.as_ptr());
+        let mut writer = 0u64;
+        unsafe {
+            assert_eq!(nominal_create_channel(self.handle, name.as_ptr(), tags_ptr, &mut writer), 0);
+        }
+        writer
+    }
+}
+
+impl Drop for FileStream {
+    fn drop(&mut self) {
+        unsafe { nominal_shutdown(self.handle) };
+        let _ = std::fs::remove_dir_all(&self.dir);
+    }
+}
+
+fn push_double_batch(c: &mut Criterion) {
+    let stream = FileStream::new("push");
+    let writer = stream.channel("push", None);
+
+    let mut group = c.benchmark_group("push_double_batch");
+    for size in BATCH_SIZES {
+        let timestamps: Vec<u64> = (0..size as u64).collect();
+        let values: Vec<f64> = (0..size).map(|v| v as f64).collect();
+        group.throughput(Throughput::Elements(size as u64));
+        if size >= 100_000 {
+            group.sample_size(10);
+        }
+        // Checked once up front; asserting inside the loop would be measured
+        unsafe { assert_eq!(nominal_push_double_batch(writer, timestamps.as_ptr(), values.as_ptr(), size), 0) };
+        group.bench_with_input(BenchmarkId::from_parameter(size), &size, |b, &size| {
+            b.iter(|| unsafe {
+                let result =
+                    nominal_push_double_batch(writer, black_box(timestamps.as_ptr()), black_box(values.as_ptr()), size);
+                debug_assert_eq!(result, 0);
+                result
+            })
+        });
+    }
+    group.finish();
+    unsafe { nominal_close_channel(writer) };
+}
+
+fn create_channel(c: &mut Criterion) {
+    let stream = FileStream::new("create");
+    let mut group = c.benchmark_group("create_channel");
+    for (label, tags) in [("no_tags", None), ("tags", Some("rig=7,test=burn_in,operator=ops,unit=degC"))] {
+        group.bench_function(label, |b| {
+            // Time only the create; closing the channel is not part of it
+            b.iter_custom(|iters| {
+                let mut total = Duration::ZERO;
+                for _ in 0..iters {
+                    let start = Instant::now();
+                    let writer = stream.channel("temperature", tags);
+                    total += start.elapsed();
+                    unsafe { nominal_close_channel(writer) };
+                }
+                total
+            })
+        });
+    }
+    group.finish();
+}
+
+fn parse_tags(c: &mut Criterion) {
+    let mut group = c.benchmark_group("parse_tags_csv");
+    for count in [0usize, 1, 4, 16] {
+        let csv: Vec<String> = (0..count).map(|i| format!("key{}=value{}", i, i)).collect();
+        let csv = csv.join(",");
+        group.bench_with_input(BenchmarkId::from_parameter(count), &csv, |b, csv| {
+            b.iter(|| parse_tags_csv(black_box(csv)))
+        });
+    }
+    group.finish();
+}
+
+fn handle_lookup(c: &mut Criterion) {
+    let table: Arc<HandleTable<u64>> = Arc::new(HandleTable::new());
+    let handles: Arc<Vec<u64>> = Arc::new(
+        (0..LOOKUP_HANDLES as u64)
+            .map(|i| table.insert(Arc::new(i)).unwrap())
+            .collect(),
+    );
+
+    let mut group = c.benchmark_group("handle_lookup");
+    for threads in LOOKUP_THREADS {
+        group.bench_with_input(BenchmarkId::from_parameter(threads), &threads, |b, &threads| {
+            // Every thread does `iters` lookups; the time per lookup is the
+            // wall time of the slowest thread
+            b.iter_custom(|iters| {
+                let barrier = Arc::new(Barrier::new(threads));
+                let workers: Vec<_> = (0..threads)
+                    .map(|t| {
+                        let (table, handles, barrier) = (Arc::clone(&table), Arc::clone(&handles), Arc::clone(&barrier));
+                        std::thread::spawn(move || {
+                            barrier.wait();
+                            let start = Instant::now();
+                            for i in 0..iters as usize {
+                                black_box(table.get(handles[(i + t) % LOOKUP_HANDLES]));
+                            }
+                            start.elapsed()
+                        })
+                    })
+                    .collect();
+                workers.into_iter().map(|w| w.join().unwrap()).max().unwrap()
+            })
+        });
+    }
+    group.finish();
+}
+
+criterion_group!(benches, push_double_batch, create_channel, parse_tags, handle_lookup);
+criterion_main!(benches);
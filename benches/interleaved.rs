@@ -0,0 +1,65 @@
+//! Interleaved (timestamp, value) pushes versus the two-array path.
+//!
+//! Compares `nominal_push_points_xy` against what Push Points Batch_XY.vi did
+//! before: split the cluster array into two arrays, then call
+//! `nominal_push_double_batch`. Run with `cargo bench --bench interleaved`.
+
+use nominal_labview_ffi::{
+    nominal_close_channel, nominal_create_channel, nominal_init, nominal_push_double_batch,
+    nominal_push_points_xy, nominal_shutdown, PointXY,
+};
+use std::ffi::CString;
+use std::time::{Duration, Instant};
+
+const RUN_TIME: Duration = Duration::from_secs(1);
+
+fn rate(mut push: impl FnMut() -> usize) -> f64 {
+    let start = Instant::now();
+    let mut pushed = 0usize;
+    while start.elapsed() < RUN_TIME {
+        pushed += push();
+    }
+    pushed as f64 / start.elapsed().as_secs_f64()
+}
+
+fn main() {
+    let dir = std::env::temp_dir().join("nominal_ffi_interleaved");
+    std::fs::create_dir_all(&dir).unwrap();
+    let path = CString::new(dir.join("bench.avro").to_str().unwrap()).unwrap();
+    let rid = CString::new("ri.catalog.main.dataset.bench").unwrap();
+    let name = CString::new("interleaved").unwrap();
+
+    let mut stream = 0u64;
+    let mut writer = 0u64;
+    unsafe {
+        assert_eq!(nominal_init(std::ptr::null(), rid.as_ptr(), path.as_ptr(), &mut stream), 0);
+        assert_eq!(nominal_create_channel(stream, name.as_ptr(), std::ptr::null(), &mut writer), 0);
+    }
+
+    println!("{:>10} {:>18} {:>18}", "batch", "two-array pts/s", "interleaved pts/s");
+    for batch in [100usize, 10_000, 1_000_000] {
+        let points: Vec<PointXY> = (0..batch)
+            .map(|i| PointXY { timestamp_ns: 1_000_000 + i as u64, value: i as f64 })
+            .collect();
+
+        let two_array = rate(|| {
+            // The reshape LabVIEW performs before the two-array call
+            let timestamps: Vec<u64> = points.iter().map(|p| p.timestamp_ns).collect();
+            let values: Vec<f64> = points.iter().map(|p| p.value).collect();
+            unsafe { assert_eq!(nominal_push_double_batch(writer, timestamps.as_ptr(), values.as_ptr(), batch), 0) };
+            batch
+        });
+        let interleaved = rate(|| {
+            unsafe { assert_eq!(nominal_push_points_xy(writer, points.as_ptr(), batch), 0) };
+            batch
+        });
+
+        println!("{:>10} {:>18.0} {:>18.0}", batch, two_array, interleaved);
+    }
+
+    unsafe {
+        nominal_close_channel(writer);
+        nominal_shutdown(stream);
+    }
+    let _ = std::fs::remove_dir_all(&dir);
+}
@@ -0,0 +1,74 @@
+//! Push throughput versus number of producer threads.
+//!
+//! Each producer owns one channel on a shared file-only stream and pushes
+//! fixed-size batches as fast as it can. Run with `cargo bench --bench push_scaling`.
+
+use nominal_labview_ffi::{
+    nominal_close_channel, nominal_create_channel, nominal_init, nominal_push_double_batch,
+    nominal_shutdown,
+};
+use std::ffi::CString;
+use std::sync::{Arc, Barrier};
+use std::time::{Duration, Instant};
+
+const BATCH: usize = 100;
+const RUN_TIME: Duration = Duration::from_secs(2);
+
+fn run(stream: u64, producers: usize) -> f64 {
+    let barrier = Arc::new(Barrier::new(producers + 1));
+    let threads: Vec<_> = (0..producers)
+        .map(|i| {
+            let barrier = Arc::clone(&barrier);
+            std::thread::spawn(move || {
+                let name = CString::new(format!("bench_{}_{}", producers, i)).unwrap();
+                let mut writer = 0u64;
+                unsafe {
+                    assert_eq!(
+                        nominal_create_channel(stream, name.as_ptr(), std::ptr::null(), &mut writer),
+                        0
+                    );
+                }
+                let timestamps: Vec<u64> = (0..BATCH as u64).map(|t| 1_000_000 + t).collect();
+                let values: Vec<f64> = (0..BATCH).map(|v| v as f64).collect();
+
+                barrier.wait();
+                let start = Instant::now();
+                let mut pushed = 0u64;
+                while start.elapsed() < RUN_TIME {
+                    unsafe {
+                        assert_eq!(nominal_push_double_batch(writer, timestamps.as_ptr(), values.as_ptr(), BATCH), 0);
+                    }
+                    pushed += BATCH as u64;
+                }
+                unsafe { nominal_close_channel(writer) };
+                pushed
+            })
+        })
+        .collect();
+
+    barrier.wait();
+    let start = Instant::now();
+    let total: u64 = threads.into_iter().map(|t| t.join().unwrap()).sum();
+    total as f64 / start.elapsed().as_secs_f64()
+}
+
+fn main() {
+    let dir = std::env::temp_dir().join("nominal_ffi_push_scaling");
+    std::fs::create_dir_all(&dir).unwrap();
+    let path = CString::new(dir.join("bench.avro").to_str().unwrap()).unwrap();
+    let rid = CString::new("ri.catalog.main.dataset.bench").unwrap();
+
+    let mut stream = 0u64;
+    unsafe {
+        assert_eq!(nominal_init(std::ptr::null(), rid.as_ptr(), path.as_ptr(), &mut stream), 0);
+    }
+
+    println!("{:>10} {:>16} {:>16}", "producers", "points/s", "per producer");
+    for producers in [1, 2, 4, 8, 16] {
+        let rate = run(stream, producers);
+        println!("{:>10} {:>16.0} {:>16.0}", producers, rate, rate / producers as f64);
+    }
+
+    unsafe { nominal_shutdown(stream) };
+    let _ = std::fs::remove_dir_all(&dir);
+}
@@ -0,0 +1,195 @@
+//! Push-to-stream throughput across channel count, batch size and producer
+//! threads.
+//!
+//! For each combination, the producers split the channels between them and
+//! push fixed-size batches round-robin for a fixed time. The stream is then
+//! shut down, and the time until every point has left it counts towards the
+//! run. Reported per run:
+//!
+//! * points/s and MB/s of raw point data, from first push to drained stream
+//! * process CPU time per point, which includes the runtime's encoding work
+//!   (Linux only)
+//! * p99 push latency, from `nominal_get_stream_stats`
+//!
+//! Streams go to their fallback file by default, so this runs offline and
+//! in CI, and measures the FFI, channels and stream encoding but not the
+//! network. There is no mock ingest server: the stream's endpoint isn't
+//! configurable through this crate. Set `NOMINAL_TOKEN` and
+//! `NOMINAL_BENCH_RID` to stream to Core itself instead. Set
+//! `NOMINAL_BENCH_CSV` to a path to also append the results there, tagged
+//! with the crate version, for comparison across releases. Run with
+//! `cargo bench --bench throughput`.
+
+use nominal_labview_ffi::{
+    nominal_create_channel, nominal_get_stream_stats, nominal_init_ex, nominal_push_double_batch,
+    nominal_shutdown_ex, NominalShutdownReport, NominalStreamOptions, NominalStreamStats,
+};
+use std::ffi::CString;
+use std::io::Write;
+use std::sync::{Arc, Barrier};
+use std::time::{Duration, Instant};
+
+const RUN_TIME: Duration = Duration::from_secs(1);
+const CHANNELS: [usize; 3] = [1, 64, 1024];
+const BATCHES: [usize; 3] = [10, 100, 1000];
+const PRODUCERS: [usize; 3] = [1, 4, 16];
+
+struct Sample {
+    points_per_second: f64,
+    bytes_per_second: f64,
+    cpu_ns_per_point: Option<f64>,
+    p99_push_ns: u64,
+}
+
+/// CPU time used by the whole process so far
+#[cfg(target_os = "linux")]
+fn process_cpu_time() -> Option<Duration> {
+    let mut usage: libc::rusage = unsafe { std::mem::zeroed() };
+    if unsafe { libc::getrusage(libc::RUSAGE_SELF, &mut usage) } != 0 {
+        return None;
+    }
+    let time = |t: libc::timeval| Duration::new(t.tv_sec as u64, t.tv_usec as u32 * 1000);
+    Some(time(usage.ru_utime) + time(usage.ru_stime))
+}
+
+#[cfg(not(target_os = "linux"))]
+fn process_cpu_time() -> Option<Duration> {
+    None
+}
+
+fn run(rid: &CString, path: &CString, channels: usize, batch: usize, producers: usize) -> Sample {
+    let options = NominalStreamOptions {
+        struct_size: std::mem::size_of::<NominalStreamOptions>() as u64,
+        ..Default::default()
+    };
+    let mut stream = 0u64;
+    unsafe {
+        assert_eq!(
+            nominal_init_ex(std::ptr::null(), rid.as_ptr(), path.as_ptr(), &options, &mut stream),
+            0
+        );
+    }
+
+    let writers: Vec<u64> = (0..channels)
+        .map(|i| {
+            let name = CString::new(format!("bench_{}", i)).unwrap();
+            let mut writer = 0u64;
+            unsafe {
+                assert_eq!(nominal_create_channel(stream, name.as_ptr(), std::ptr::null(), &mut writer), 0);
+            }
+            writer
+        })
+        .collect();
+
+    let barrier = Arc::new(Barrier::new(producers + 1));
+    let threads: Vec<_> = (0..producers)
+        .map(|p| {
+            // Producer p owns every channel i with i % producers == p
+            let owned: Vec<u64> = writers.iter().copied().skip(p).step_by(producers).collect();
+            let barrier = Arc::clone(&barrier);
+            std::thread::spawn(move || {
+                let mut timestamps: Vec<u64> = (0..batch as u64).collect();
+                let values: Vec<f64> = (0..batch).map(|v| v as f64).collect();
+                barrier.wait();
+                let start = Instant::now();
+                let mut pushed = 0u64;
+                while !owned.is_empty() && start.elapsed() < RUN_TIME {
+                    for &writer in &owned {
+                        let result =
+                            unsafe { nominal_push_double_batch(writer, timestamps.as_ptr(), values.as_ptr(), batch) };
+                        assert_eq!(result, 0);
+                    }
+                    pushed += (batch * owned.len()) as u64;
+                    for t in &mut timestamps {
+                        *t += batch as u64;
+                    }
+                }
+                pushed
+            })
+        })
+        .collect();
+
+    let cpu_start = process_cpu_time();
+    barrier.wait();
+    let start = Instant::now();
+    let pushed: u64 = threads.into_iter().map(|t| t.join().unwrap()).sum();
+
+    let mut stats = NominalStreamStats {
+        struct_size: std::mem::size_of::<NominalStreamStats>() as u64,
+        ..Default::default()
+    };
+    unsafe { assert_eq!(nominal_get_stream_stats(stream, &mut stats), 0) };
+
+    let mut report = NominalShutdownReport::default();
+    unsafe { assert_eq!(nominal_shutdown_ex(stream, 60_000, &mut report), 0) };
+    let elapsed = start.elapsed().as_secs_f64();
+    assert_eq!(report.points_sent, pushed);
+
+    let cpu_ns_per_point = match (cpu_start, process_cpu_time()) {
+        (Some(before), Some(after)) if pushed > 0 => Some((after - before).as_nanos() as f64 / pushed as f64),
+        _ => None,
+    };
+    Sample {
+        points_per_second: pushed as f64 / elapsed,
+        bytes_per_second: stats.bytes_accepted as f64 / elapsed,
+        cpu_ns_per_point,
+        p99_push_ns: stats.push_latency.p99_ns,
+    }
+}
+
+fn main() {
+    let dir = std::env::temp_dir().join("nominal_ffi_throughput");
+    std::fs::create_dir_all(&dir).unwrap();
+    let path = CString::new(dir.join("bench.avro").to_str().unwrap()).unwrap();
+    let rid = std::env::var("NOMINAL_BENCH_RID").unwrap_or_else(|_| "ri.catalog.main.dataset.bench".to_string());
+    let rid = CString::new(rid).unwrap();
+
+    let mut csv = std::env::var("NOMINAL_BENCH_CSV").ok().map(|csv_path| {
+        let new = !std::path::Path::new(&csv_path).exists();
+        let mut file = std::fs::OpenOptions::new().create(true).append(true).open(&csv_path).unwrap();
+        if new {
+            writeln!(file, "version,channels,batch,producers,points_per_s,bytes_per_s,cpu_ns_per_point,p99_push_ns").unwrap();
+        }
+        file
+    });
+
+    println!(
+        "{:>9} {:>7} {:>10} {:>14} {:>10} {:>14} {:>14}",
+        "channels", "batch", "producers", "points/s", "MB/s", "cpu ns/point", "p99 push us"
+    );
+    for channels in CHANNELS {
+        for batch in BATCHES {
+            for producers in PRODUCERS.into_iter().filter(|&p| p <= channels) {
+                let sample = run(&rid, &path, channels, batch, producers);
+                let cpu = sample.cpu_ns_per_point.map_or("n/a".to_string(), |ns| format!("{:.1}", ns));
+                println!(
+                    "{:>9} {:>7} {:>10} {:>14.0} {:>10.1} {:>14} {:>14.1}",
+                    channels,
+                    batch,
+                    producers,
+                    sample.points_per_second,
+                    sample.bytes_per_second / 1e6,
+                    cpu,
+                    sample.p99_push_ns as f64 / 1000.0
+                );
+                if let Some(file) = &mut csv {
+                    writeln!(
+                        file,
+                        "{},{},{},{},{:.0},{:.0},{},{}",
+                        env!("CARGO_PKG_VERSION"),
+                        channels,
+                        batch,
+                        producers,
+                        sample.points_per_second,
+                        sample.bytes_per_second,
+                        sample.cpu_ns_per_point.map_or(String::new(), |ns| format!("{:.1}", ns)),
+                        sample.p99_push_ns
+                    )
+                    .unwrap();
+                }
+            }
+        }
+    }
+
+    let _ = std::fs::remove_dir_all(&dir);
+}
@@ -0,0 +1,589 @@
+//! Per-handle channel state.
+//!
+//! A `Channel` owns the long-lived writer for one channel handle. Pushes either
+//! append to that writer on the caller's thread (the default), or, once async
+//! mode is enabled, only copy into a preallocated SPSC ring that a task on the
+//! global runtime drains into the writer. When a ring has no room for a batch,
+//! the stream's backpressure policy decides what happens to it.
+//!
+//! Draining can block: the writer waits when the stream's buffers are full,
+//! and a spool writes and syncs files. The drain task therefore only waits
+//! for work on the runtime and does each drain on the blocking pool, so a
+//! stalled channel never holds a worker that uploads need. This matters most
+//! with a current-thread runtime, which has just the one.
+//!
+//! A channel with compression set runs each batch through its `Compressor`
+//! first, and only the points it keeps go on to the writer or ring.
+
+use crate::compression::Compressor;
+use crate::ring::{RingProducer, SpscRing};
+use crate::scaling::Polynomial;
+use crate::spool::SpoolWriter;
+use crate::stats::{self, ChannelStats};
+use crate::stream::{Backpressure, ChannelKey, StreamState};
+use crate::{set_last_error, set_last_error_fmt, ERROR_INVALID_PARAM, ERROR_IO, ERROR_QUEUE_FULL, RUNTIME};
+use nominal_streaming::prelude::*;
+use nominal_streaming::stream::{NominalDatasetStream, NominalDoubleWriter};
+use once_cell::sync::OnceCell;
+use parking_lot::Mutex;
+use std::cell::RefCell;
+use std::os::raw::c_int;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Arc;
+use std::time::{Duration, Instant};
+use tokio::sync::Notify;
+use tokio::task::JoinHandle;
+
+// Store writers along with their stream and descriptor to maintain lifetimes.
+// The writer borrows both, so it is kept alive for the whole life of the handle
+// and every push appends straight into its existing buffer.
+pub(crate) struct WriterState {
+    // Declared first so it is dropped (and flushed) before the stream and
+    // descriptor it borrows from.
+    writer: NominalDoubleWriter<'static>,
+    pub(crate) descriptor: Arc<ChannelDescriptor>,
+    #[allow(dead_code)] // Held only to keep the writer's borrow alive
+    stream: Arc<NominalDatasetStream>,
+    // Spooled copy of every point, see `spool`. Dropped after `writer`, so
+    // its segments are deleted only once the writer has flushed them.
+    spool: Option<SpoolWriter>,
+}
+
+impl WriterState {
+    pub(crate) fn new(stream: Arc<NominalDatasetStream>, descriptor: Arc<ChannelDescriptor>) -> Self {
+        Self {
+            writer: unsafe { open_writer(&stream, &descriptor) },
+            descriptor,
+            stream,
+            spool: None,
+        }
+    }
+
+    /// Also record every point to a spool
+    pub(crate) fn with_spool(mut self, spool: SpoolWriter) -> Self {
+        self.spool = Some(spool);
+        self
+    }
+
+    /// Hand every buffered point to the stream and continue in a new buffer
+    pub(crate) fn flush(&mut self) {
+        if let Some(spool) = &mut self.spool {
+            spool.seal();
+        }
+        // Assigning drops the old writer, which flushes it
+        self.writer = unsafe { open_writer(&self.stream, &self.descriptor) };
+        if let Some(spool) = &mut self.spool {
+            spool.ack();
+        }
+    }
+
+    /// Write the points pushed so far through to the spool file, if any
+    #[inline]
+    pub(crate) fn end_batch(&mut self) {
+        if let Some(spool) = &mut self.spool {
+            if spool.write_through() {
+                self.flush();
+            }
+        }
+    }
+
+    /// Append one point to the channel's buffer
+    #[inline]
+    pub(crate) fn push(&mut self, timestamp_ns: u64, value: f64) {
+        self.writer.push(Duration::from_nanos(timestamp_ns), value);
+        if let Some(spool) = &mut self.spool {
+            if spool.push(timestamp_ns, value) {
+                // The spool segment is full; once the stream has its points
+                // it can be deleted
+                self.flush();
+            }
+        }
+    }
+}
+
+/// Descriptor for a channel name and its tags
+pub(crate) fn descriptor(name: &str, tags: &[(&str, &str)]) -> ChannelDescriptor {
+    if tags.is_empty() {
+        ChannelDescriptor::new(name)
+    } else {
+        ChannelDescriptor::with_tags(name, tags.iter().copied())
+    }
+}
+
+// SAFETY: the stream and descriptor are heap allocations owned by the
+// `WriterState` through `Arc`s, so their addresses stay fixed when the state
+// moves. Neither is replaced while the writer exists, and `writer` is declared
+// first so it is dropped before either of them.
+unsafe fn open_writer(
+    stream: &Arc<NominalDatasetStream>,
+    descriptor: &Arc<ChannelDescriptor>,
+) -> NominalDoubleWriter<'static> {
+    let stream_ref: &'static NominalDatasetStream = &*Arc::as_ptr(stream);
+    let descriptor_ref: &'static ChannelDescriptor = &*Arc::as_ptr(descriptor);
+    stream_ref.double_writer(descriptor_ref)
+}
+
+/// Destination for one push call's points
+pub(crate) enum PointSink<'a, 'r> {
+    Writer(&'a mut WriterState),
+    Ring(RingSink<'a, 'r>),
+    // Points the compressor keeps, collected before they go to the channel
+    Compress(&'a mut Compressor, &'a mut Vec<(u64, f64)>),
+}
+
+impl PointSink<'_, '_> {
+    #[inline]
+    pub(crate) fn push(&mut self, timestamp_ns: u64, value: f64) {
+        match self {
+            PointSink::Writer(state) => state.push(timestamp_ns, value),
+            PointSink::Ring(sink) => sink.push(timestamp_ns, value),
+            PointSink::Compress(compressor, kept) => {
+                compressor.push(timestamp_ns, value, &mut |t, v| kept.push((t, v)))
+            }
+        }
+    }
+}
+
+thread_local! {
+    // Points kept by compression for the batch being pushed, reused so
+    // compressed pushes don't allocate in steady state
+    static COMPRESSED: RefCell<Vec<(u64, f64)>> = const { RefCell::new(Vec::new()) };
+}
+
+/// Where points that don't fit in the ring go
+enum Overflow<'a> {
+    Drop,
+    Spill(&'a mut WriterState),
+}
+
+/// Ring producer plus the backpressure bookkeeping for one batch
+pub(crate) struct RingSink<'a, 'r> {
+    producer: &'a mut RingProducer<'r>,
+    // Leading points of the batch that `DropOldest` discards because the
+    // batch alone is larger than the ring
+    skip: usize,
+    overflow: Overflow<'a>,
+    dropped: u64,
+    spilled: u64,
+}
+
+impl<'a, 'r> RingSink<'a, 'r> {
+    fn new(producer: &'a mut RingProducer<'r>, skip: usize, overflow: Overflow<'a>) -> Self {
+        Self {
+            producer,
+            skip,
+            overflow,
+            dropped: 0,
+            spilled: 0,
+        }
+    }
+
+    #[inline]
+    fn push(&mut self, timestamp_ns: u64, value: f64) {
+        if self.skip > 0 {
+            self.skip -= 1;
+            self.dropped += 1;
+        } else if !self.producer.push(timestamp_ns, value) {
+            match &mut self.overflow {
+                Overflow::Drop => self.dropped += 1,
+                Overflow::Spill(spill) => {
+                    spill.push(timestamp_ns, value);
+                    self.spilled += 1;
+                }
+            }
+        }
+    }
+}
+
+/// Points copied out of a ring per consumer lock hold (16 KiB on the stack)
+const DRAIN_CHUNK: usize = 1024;
+
+/// Ring and drain task for a channel in async mode
+struct AsyncQueue {
+    ring: SpscRing,
+    // Serializes producers so the ring keeps a single writer even if LabVIEW
+    // pushes to one handle from several loops
+    producer: Mutex<()>,
+    notify: Notify,
+    closed: AtomicBool,
+    drain_task: Mutex<Option<JoinHandle<()>>>,
+    // Serializes consumers: the drain while it copies a chunk out of the ring,
+    // and `DropOldest` discarding. Never held while the writer is pushed to.
+    consumer: Mutex<()>,
+    // When the oldest undrained batch was pushed, see `stats::nanos_since_epoch`;
+    // 0 when nothing is marked
+    oldest_enqueued_ns: AtomicU64,
+}
+
+impl AsyncQueue {
+    /// Note that a batch pushed at `pushed_at` is waiting, unless an older one is
+    #[inline]
+    fn mark_enqueued(&self, pushed_at: Instant) {
+        if self.oldest_enqueued_ns.load(Ordering::Relaxed) == 0 {
+            self.oldest_enqueued_ns
+                .store(stats::nanos_since_epoch(pushed_at), Ordering::Relaxed);
+        }
+    }
+}
+
+pub(crate) struct Channel {
+    pub(crate) stream: Arc<StreamState>,
+    // Interned name and tags, defaults included; where the stream's channel
+    // index lists this channel
+    pub(crate) key: ChannelKey,
+    // Shared with the writer, for opening a spill writer without its lock
+    descriptor: Arc<ChannelDescriptor>,
+    pub(crate) state: Mutex<WriterState>,
+    async_queue: OnceCell<AsyncQueue>,
+    // Writer on the stream's spill file, opened on first overflow
+    spill: Mutex<Option<WriterState>>,
+    // See nominal_set_channel_compression. Held for the whole push, so points
+    // reach the channel in the order the compressor saw them.
+    compression: Mutex<Option<Compressor>>,
+    // Applied to raw (non-double) pushes, see nominal_set_channel_scale. Its
+    // own lock, so typed pushes never wait on the writer.
+    pub(crate) scale: Mutex<Option<Polynomial>>,
+    pub(crate) stats: ChannelStats,
+}
+
+impl Channel {
+    pub(crate) fn new(
+        stream: Arc<StreamState>,
+        key: ChannelKey,
+        state: WriterState,
+    ) -> Self {
+        Self {
+            stream,
+            key,
+            descriptor: Arc::clone(&state.descriptor),
+            state: Mutex::new(state),
+            async_queue: OnceCell::new(),
+            spill: Mutex::new(None),
+            compression: Mutex::new(None),
+            scale: Mutex::new(None),
+            stats: ChannelStats::default(),
+        }
+    }
+
+    /// Run `fill` against this channel's sink for a batch of `count` points
+    ///
+    /// In async mode, a batch that doesn't fit in the ring is handled by the
+    /// stream's backpressure policy; with no policy, or when `Block` times out,
+    /// nothing is queued and `ERROR_QUEUE_FULL` is returned.
+    #[inline]
+    pub(crate) fn push_batch(&self, count: usize, fill: impl FnOnce(&mut PointSink)) -> Result<(), c_int> {
+        let start = Instant::now();
+        let mut compression = self.compression.lock();
+        let result = match compression.as_mut() {
+            None => self.push_batch_timed(start, count, fill),
+            Some(compressor) => self.push_compressed(start, compressor, count, fill),
+        };
+        drop(compression);
+        self.stats.push_latency.record(start.elapsed().as_nanos() as u64);
+        result
+    }
+
+    /// `push_batch_timed` with only the points `compressor` keeps
+    ///
+    /// The batch runs through a copy of the compressor, which replaces it
+    /// only once the points it kept are accepted. A rejected batch, such as
+    /// one refused with `ERROR_QUEUE_FULL`, leaves the compressor as it was,
+    /// so retrying it compresses against the same reference.
+    fn push_compressed(
+        &self,
+        start: Instant,
+        compressor: &mut Compressor,
+        count: usize,
+        fill: impl FnOnce(&mut PointSink),
+    ) -> Result<(), c_int> {
+        COMPRESSED.with(|kept| {
+            let mut kept = kept.borrow_mut();
+            kept.clear();
+            kept.reserve(count);
+            let mut next = compressor.clone();
+            fill(&mut PointSink::Compress(&mut next, &mut kept));
+            if !kept.is_empty() {
+                self.push_batch_timed(start, kept.len(), |sink| {
+                    for &(timestamp, value) in kept.iter() {
+                        sink.push(timestamp, value);
+                    }
+                })?;
+            }
+            self.stats
+                .points_suppressed
+                .fetch_add(next.take_suppressed(), Ordering::Relaxed);
+            *compressor = next;
+            Ok(())
+        })
+    }
+
+    /// Set or clear compression. The old compressor's held point, if any,
+    /// is pushed first.
+    pub(crate) fn set_compression(&self, compressor: Option<Compressor>) -> Result<(), c_int> {
+        let mut compression = self.compression.lock();
+        let result = self.push_pending(&mut compression);
+        *compression = compressor;
+        result
+    }
+
+    /// Push the point the compressor is holding back, if any. The compressor
+    /// only lets go of it once it is accepted.
+    fn push_pending(&self, compression: &mut Option<Compressor>) -> Result<(), c_int> {
+        let Some(compressor) = compression.as_mut() else { return Ok(()) };
+        let mut next = compressor.clone();
+        if let Some((timestamp, value)) = next.take_pending() {
+            self.push_batch_timed(Instant::now(), 1, |sink| sink.push(timestamp, value))?;
+            *compressor = next;
+        }
+        Ok(())
+    }
+
+    #[inline]
+    fn push_batch_timed(
+        &self,
+        start: Instant,
+        count: usize,
+        fill: impl FnOnce(&mut PointSink),
+    ) -> Result<(), c_int> {
+        let points_accepted = &self.stats.points_accepted;
+        let queue = match self.async_queue.get() {
+            None => {
+                let mut state = self.state.lock();
+                fill(&mut PointSink::Writer(&mut state));
+                state.end_batch();
+                points_accepted.fetch_add(count as u64, Ordering::Relaxed);
+                return Ok(());
+            }
+            Some(q) => q,
+        };
+
+        let _producer_guard = queue.producer.lock();
+        // SAFETY: the producer lock makes this the only producer
+        let mut producer = unsafe { queue.ring.producer() };
+
+        if producer.remaining() >= count {
+            fill(&mut PointSink::Ring(RingSink::new(&mut producer, 0, Overflow::Drop)));
+            producer.commit();
+            queue.mark_enqueued(start);
+            queue.notify.notify_one();
+            points_accepted.fetch_add(count as u64, Ordering::Relaxed);
+            return Ok(());
+        }
+
+        let config = &self.stream.config;
+        let counters = &self.stream.counters;
+        let mut spill_guard = None;
+        let mut skip = 0;
+        let mut discarded = 0;
+
+        match config.backpressure {
+            Backpressure::None => {
+                set_last_error_fmt(format_args!(
+                    "Async queue full: {} points pushed, {} free of {}",
+                    count,
+                    producer.remaining(),
+                    queue.ring.capacity()
+                ));
+                return Err(ERROR_QUEUE_FULL);
+            }
+            Backpressure::Block => {
+                let deadline = Instant::now() + config.block_timeout;
+                while producer.remaining() < count {
+                    if count > queue.ring.capacity() || Instant::now() >= deadline {
+                        counters.block_timeouts.fetch_add(1, Ordering::Relaxed);
+                        set_last_error_fmt(format_args!(
+                            "Async queue full after waiting {:?}: {} points pushed, {} free of {}",
+                            config.block_timeout,
+                            count,
+                            producer.remaining(),
+                            queue.ring.capacity()
+                        ));
+                        return Err(ERROR_QUEUE_FULL);
+                    }
+                    queue.notify.notify_one();
+                    std::thread::sleep(Duration::from_micros(100));
+                    producer = unsafe { queue.ring.producer() };
+                }
+            }
+            Backpressure::DropOldest => {
+                let keep = count.min(queue.ring.capacity());
+                skip = count - keep;
+                let needed = keep.saturating_sub(producer.remaining());
+                {
+                    // Waits for at most one drain chunk to be copied out, not
+                    // for the writer
+                    let _consumer = queue.consumer.lock();
+                    discarded = unsafe { queue.ring.discard(needed) };
+                }
+                producer = unsafe { queue.ring.producer() };
+            }
+            Backpressure::DropNewest => {}
+            Backpressure::Spill => {
+                let mut spill = self.spill.lock();
+                if spill.is_none() {
+                    let spill_stream = match self.stream.spill_stream() {
+                        Ok(s) => Arc::clone(s),
+                        Err(e) => {
+                            set_last_error(e);
+                            return Err(ERROR_IO);
+                        }
+                    };
+                    *spill = Some(WriterState::new(spill_stream, Arc::clone(&self.descriptor)));
+                }
+                spill_guard = Some(spill);
+            }
+        }
+
+        let overflow = match spill_guard.as_mut().and_then(|g| g.as_mut()) {
+            Some(spill) => Overflow::Spill(spill),
+            None => Overflow::Drop,
+        };
+        let mut sink = PointSink::Ring(RingSink::new(&mut producer, skip, overflow));
+        fill(&mut sink);
+        let (mut dropped, mut spilled) = (discarded as u64, 0);
+        if let PointSink::Ring(ring_sink) = sink {
+            dropped += ring_sink.dropped;
+            spilled += ring_sink.spilled;
+        }
+
+        producer.commit();
+        queue.mark_enqueued(start);
+        queue.notify.notify_one();
+
+        let accepted = (count as u64).saturating_sub(dropped + spilled);
+        points_accepted.fetch_add(accepted, Ordering::Relaxed);
+        if dropped > 0 {
+            counters.dropped_points.fetch_add(dropped, Ordering::Relaxed);
+        }
+        if spilled > 0 {
+            counters.spilled_points.fetch_add(spilled, Ordering::Relaxed);
+        }
+        Ok(())
+    }
+
+    /// Switch the channel to async mode with a ring of `capacity` points
+    pub(crate) fn enable_async(self: &Arc<Self>, capacity: usize) -> Result<(), c_int> {
+        let ring = SpscRing::new(capacity).map_err(|e| {
+            set_last_error(e);
+            ERROR_INVALID_PARAM
+        })?;
+
+        let queue = AsyncQueue {
+            ring,
+            producer: Mutex::new(()),
+            notify: Notify::new(),
+            closed: AtomicBool::new(false),
+            drain_task: Mutex::new(None),
+            consumer: Mutex::new(()),
+            oldest_enqueued_ns: AtomicU64::new(0),
+        };
+        if self.async_queue.set(queue).is_err() {
+            set_last_error("Async mode is already enabled for this channel".to_string());
+            return Err(ERROR_INVALID_PARAM);
+        }
+
+        let task = RUNTIME.spawn(drain_loop(Arc::clone(self)));
+        *self.async_queue.get().unwrap().drain_task.lock() = Some(task);
+        Ok(())
+    }
+
+    /// Move every queued point from the ring into the writer
+    fn drain(&self) -> usize {
+        let mut state = self.state.lock();
+        self.drain_into(&mut state)
+    }
+
+    /// `drain` with the writer lock already held
+    fn drain_into(&self, state: &mut WriterState) -> usize {
+        let Some(queue) = self.async_queue.get() else { return 0 };
+        let enqueued = queue.oldest_enqueued_ns.swap(0, Ordering::Relaxed);
+        // Copy out a chunk at a time under the consumer lock, and push it to
+        // the writer without it. Stop at what was queued on entry, so a busy
+        // producer can't keep the drain going forever.
+        let mut chunk = [(0u64, 0.0f64); DRAIN_CHUNK];
+        let mut remaining = queue.ring.len();
+        let mut drained = 0;
+        while remaining > 0 {
+            let n = {
+                let _consumer = queue.consumer.lock();
+                // SAFETY: the consumer lock makes this the only consumer
+                unsafe { queue.ring.take(&mut chunk[..remaining.min(DRAIN_CHUNK)]) }
+            };
+            if n == 0 {
+                break; // DropOldest discarded the rest
+            }
+            for &(timestamp, value) in &chunk[..n] {
+                state.push(timestamp, value);
+            }
+            state.end_batch();
+            remaining -= n;
+            drained += n;
+        }
+        if drained > 0 && enqueued != 0 {
+            let now = stats::nanos_since_epoch(Instant::now());
+            self.stats.queue_latency.record(now.saturating_sub(enqueued));
+        }
+        drained
+    }
+
+    /// Points waiting in the async ring
+    pub(crate) fn queued_points(&self) -> usize {
+        self.async_queue.get().map_or(0, |queue| queue.ring.len())
+    }
+
+    /// Move every queued point into the writer and hand the writer's buffer
+    /// (and the spill writer's, if any) to the stream. Pushes to this channel
+    /// wait while it runs.
+    pub(crate) fn flush(&self) {
+        // A failure is already counted by the backpressure policy
+        let _ = self.push_pending(&mut self.compression.lock());
+        {
+            let mut state = self.state.lock();
+            self.drain_into(&mut state);
+            let start = Instant::now();
+            state.flush();
+            self.stats.flush_latency.record(start.elapsed().as_nanos() as u64);
+        }
+        if let Some(spill) = self.spill.lock().as_mut() {
+            spill.flush();
+        }
+    }
+
+    /// Stop the drain task after it has moved every queued point into the
+    /// writer. The writer itself flushes when the last reference is dropped.
+    pub(crate) fn close(&self) {
+        RUNTIME.block_on(self.close_async());
+    }
+
+    /// `close` for callers already on the runtime
+    pub(crate) async fn close_async(&self) {
+        let _ = self.push_pending(&mut self.compression.lock());
+        let Some(queue) = self.async_queue.get() else { return };
+        queue.closed.store(true, Ordering::Release);
+        queue.notify.notify_one();
+        let task = queue.drain_task.lock().take();
+        if let Some(task) = task {
+            let _ = task.await;
+        }
+    }
+}
+
+impl Drop for Channel {
+    fn drop(&mut self) {
+        // Keep the stream's totals covering closed channels
+        self.stream.retired_stats.absorb(&self.stats);
+    }
+}
+
+async fn drain_loop(channel: Arc<Channel>) {
+    let queue = channel.async_queue.get().expect("drain task started without a queue");
+    loop {
+        queue.notify.notified().await;
+        let closed = queue.closed.load(Ordering::Acquire);
+        let draining = Arc::clone(&channel);
+        let _ = tokio::task::spawn_blocking(move || draining.drain()).await;
+        if closed {
+            break;
+        }
+    }
+}
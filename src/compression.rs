@@ -0,0 +1,288 @@
+//! Per-channel compression ahead of the stream.
+//!
+//! Slow signals sampled fast (thermocouples, static pressures) mostly repeat
+//! themselves. A channel can drop such points on the push path, before they
+//! take ring space, spool disk or upload bandwidth:
+//!
+//! * Deadband keeps a point when it differs from the last kept value by more
+//!   than the deviation.
+//! * Swinging door keeps a point once no straight line from the last kept
+//!   point passes within the deviation of every point since. Lines between
+//!   kept points then pass within twice the deviation of every dropped one.
+//!   The newest point is held back until a later one shows whether it is
+//!   needed; a flush or close of the channel emits it.
+//!
+//! The deviation is either absolute, or a percentage of the magnitude of the
+//! last kept value. A maximum interval forces a point out when nothing has
+//! been kept for that long, so quiet channels still show they are alive.
+//! Non-finite values and timestamps that don't increase are always kept.
+
+/// Compression algorithms for `nominal_set_channel_compression`
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum Mode {
+    Deadband,
+    SwingingDoor,
+}
+
+impl Mode {
+    /// Mode for the FFI code; 0 (off) is `None`
+    pub fn from_code(code: u32) -> Result<Option<Self>, String> {
+        match code {
+            0 => Ok(None),
+            1 => Ok(Some(Mode::Deadband)),
+            2 => Ok(Some(Mode::SwingingDoor)),
+            _ => Err(format!("Invalid compression mode: {} (expected 0 to 2)", code)),
+        }
+    }
+}
+
+/// Compression state for one channel
+#[derive(Clone, Debug)]
+pub struct Compressor {
+    mode: Mode,
+    deviation: f64,
+    percent: bool,
+    // 0 for no limit
+    max_interval_ns: u64,
+    // Last point emitted
+    archived: Option<(u64, f64)>,
+    // Swinging door: newest point, not yet emitted
+    held: Option<(u64, f64)>,
+    // Swinging door: slopes of the corridor from `archived`
+    upper_slope: f64,
+    lower_slope: f64,
+    // Points dropped since `take_suppressed`
+    suppressed: u64,
+}
+
+impl Compressor {
+    /// `deviation` is in the channel's units, or in percent when `percent`
+    /// is set. A `max_interval_ns` of 0 means no limit.
+    pub fn new(mode: Mode, deviation: f64, percent: bool, max_interval_ns: u64) -> Result<Self, String> {
+        if !deviation.is_finite() || deviation < 0.0 {
+            return Err(format!("Compression deviation must be finite and >= 0, got {}", deviation));
+        }
+        Ok(Self {
+            mode,
+            deviation: if percent { deviation / 100.0 } else { deviation },
+            percent,
+            max_interval_ns,
+            archived: None,
+            held: None,
+            upper_slope: f64::INFINITY,
+            lower_slope: f64::NEG_INFINITY,
+            suppressed: 0,
+        })
+    }
+
+    /// Deviation allowed around a point kept with value `reference`
+    #[inline]
+    fn deviation(&self, reference: f64) -> f64 {
+        if self.percent {
+            self.deviation * reference.abs()
+        } else {
+            self.deviation
+        }
+    }
+
+    #[inline]
+    fn overdue(&self, archived_ns: u64, timestamp_ns: u64) -> bool {
+        self.max_interval_ns > 0 && timestamp_ns.saturating_sub(archived_ns) >= self.max_interval_ns
+    }
+
+    /// Take one point, passing every point it decides to keep to `emit`
+    #[inline]
+    pub fn push(&mut self, timestamp_ns: u64, value: f64, emit: &mut impl FnMut(u64, f64)) {
+        match self.mode {
+            Mode::Deadband => self.push_deadband(timestamp_ns, value, emit),
+            Mode::SwingingDoor => self.push_swinging_door(timestamp_ns, value, emit),
+        }
+    }
+
+    #[inline]
+    fn push_deadband(&mut self, timestamp_ns: u64, value: f64, emit: &mut impl FnMut(u64, f64)) {
+        if let Some((archived_ns, archived_value)) = self.archived {
+            let within = value.is_finite()
+                && archived_value.is_finite()
+                && timestamp_ns > archived_ns
+                && (value - archived_value).abs() <= self.deviation(archived_value);
+            if within && !self.overdue(archived_ns, timestamp_ns) {
+                self.suppressed += 1;
+                return;
+            }
+        }
+        self.archive(timestamp_ns, value, emit);
+    }
+
+    #[inline]
+    fn push_swinging_door(&mut self, timestamp_ns: u64, value: f64, emit: &mut impl FnMut(u64, f64)) {
+        let Some((archived_ns, archived_value)) = self.archived else {
+            return self.archive(timestamp_ns, value, emit);
+        };
+        let last_ns = self.held.map_or(archived_ns, |(held_ns, _)| held_ns);
+        if !value.is_finite() || !archived_value.is_finite() || timestamp_ns <= last_ns {
+            // No corridor through this point; keep everything up to it
+            self.emit_held(emit);
+            return self.archive(timestamp_ns, value, emit);
+        }
+
+        if self.overdue(archived_ns, timestamp_ns) {
+            if !self.emit_held(emit) {
+                return self.archive(timestamp_ns, value, emit);
+            }
+            if let Some((archived_ns, _)) = self.archived {
+                if self.overdue(archived_ns, timestamp_ns) {
+                    return self.archive(timestamp_ns, value, emit);
+                }
+            }
+        }
+
+        if !self.narrow(timestamp_ns, value) {
+            // Outside the corridor: the held point is needed, and the
+            // corridor starts again from it
+            self.emit_held(emit);
+            self.narrow(timestamp_ns, value);
+        }
+        if self.held.replace((timestamp_ns, value)).is_some() {
+            self.suppressed += 1;
+        }
+    }
+
+    /// Narrow the corridor to pass within the deviation of a point, unless
+    /// that would close it. Returns whether the point fits.
+    #[inline]
+    fn narrow(&mut self, timestamp_ns: u64, value: f64) -> bool {
+        let (archived_ns, archived_value) = self.archived.expect("corridor without an archived point");
+        let deviation = self.deviation(archived_value);
+        let dt = (timestamp_ns - archived_ns) as f64;
+        let upper = self.upper_slope.min((value + deviation - archived_value) / dt);
+        let lower = self.lower_slope.max((value - deviation - archived_value) / dt);
+        if lower > upper {
+            return false;
+        }
+        self.upper_slope = upper;
+        self.lower_slope = lower;
+        true
+    }
+
+    /// Emit a point and start a new corridor from it
+    #[inline]
+    fn archive(&mut self, timestamp_ns: u64, value: f64, emit: &mut impl FnMut(u64, f64)) {
+        emit(timestamp_ns, value);
+        self.archived = Some((timestamp_ns, value));
+        self.upper_slope = f64::INFINITY;
+        self.lower_slope = f64::NEG_INFINITY;
+    }
+
+    /// Emit and archive the held point, if any
+    #[inline]
+    fn emit_held(&mut self, emit: &mut impl FnMut(u64, f64)) -> bool {
+        match self.held.take() {
+            Some((timestamp_ns, value)) => {
+                self.archive(timestamp_ns, value, emit);
+                true
+            }
+            None => false,
+        }
+    }
+
+    /// The held point, archived as if emitted; for flushing the channel
+    pub fn take_pending(&mut self) -> Option<(u64, f64)> {
+        let mut pending = None;
+        self.emit_held(&mut |timestamp_ns, value| pending = Some((timestamp_ns, value)));
+        pending
+    }
+
+    /// Points dropped since the last call
+    pub fn take_suppressed(&mut self) -> u64 {
+        std::mem::take(&mut self.suppressed)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn run(compressor: &mut Compressor, points: &[(u64, f64)]) -> Vec<(u64, f64)> {
+        let mut kept = Vec::new();
+        for &(timestamp_ns, value) in points {
+            compressor.push(timestamp_ns, value, &mut |t, v| kept.push((t, v)));
+        }
+        kept.extend(compressor.take_pending());
+        kept
+    }
+
+    #[test]
+    fn test_deadband() {
+        let mut absolute = Compressor::new(Mode::Deadband, 0.5, false, 0).unwrap();
+        let points = [(0, 1.0), (1, 1.4), (2, 0.6), (3, 1.6), (4, 1.2), (5, f64::NAN), (6, 1.2)];
+        assert_eq!(
+            format!("{:?}", run(&mut absolute, &points)),
+            format!("{:?}", [(0, 1.0), (3, 1.6), (5, f64::NAN), (6, 1.2)])
+        );
+        assert_eq!(absolute.take_suppressed(), 3);
+
+        // 10% of 100 is 10, then 10% of 111 is 11.1
+        let mut percent = Compressor::new(Mode::Deadband, 10.0, true, 0).unwrap();
+        let points = [(0, 100.0), (1, 109.0), (2, 111.0), (3, 122.0), (4, 123.0)];
+        assert_eq!(run(&mut percent, &points), [(0, 100.0), (2, 111.0), (4, 123.0)]);
+    }
+
+    #[test]
+    fn test_max_interval() {
+        let mut deadband = Compressor::new(Mode::Deadband, 1.0, false, 10).unwrap();
+        let flat: Vec<(u64, f64)> = (0..25).map(|t| (t, 5.0)).collect();
+        assert_eq!(run(&mut deadband, &flat), [(0, 5.0), (10, 5.0), (20, 5.0)]);
+
+        let mut door = Compressor::new(Mode::SwingingDoor, 1.0, false, 10).unwrap();
+        let kept = run(&mut door, &flat);
+        assert_eq!(kept.first(), Some(&(0, 5.0)));
+        assert_eq!(kept.last(), Some(&(24, 5.0)));
+        assert!(kept.windows(2).all(|w| w[1].0 - w[0].0 <= 10), "{:?}", kept);
+    }
+
+    #[test]
+    fn test_swinging_door_keeps_corners() {
+        // Ramp up, then flat: only the ends and the corner are needed
+        let mut door = Compressor::new(Mode::SwingingDoor, 0.1, false, 0).unwrap();
+        let points: Vec<(u64, f64)> = (0..=20).map(|t| (t, if t <= 10 { t as f64 } else { 10.0 })).collect();
+        assert_eq!(run(&mut door, &points), [(0, 0.0), (10, 10.0), (20, 10.0)]);
+        assert_eq!(door.take_suppressed(), 18);
+    }
+
+    #[test]
+    fn test_swinging_door_within_deviation() {
+        let deviation = 0.05;
+        let mut door = Compressor::new(Mode::SwingingDoor, deviation, false, 0).unwrap();
+        let points: Vec<(u64, f64)> = (0..2000u64).map(|t| (t * 1000, (t as f64 / 100.0).sin())).collect();
+        let kept = run(&mut door, &points);
+        assert!(kept.len() < points.len() / 10, "kept {} of {}", kept.len(), points.len());
+
+        // Every dropped point lies within twice the deviation of the line
+        // between the kept points around it
+        for &(t, v) in &points {
+            let i = kept.partition_point(|&(kt, _)| kt <= t);
+            if kept[i - 1].0 == t {
+                continue;
+            }
+            let ((t0, v0), (t1, v1)) = (kept[i - 1], kept[i]);
+            let interpolated = v0 + (v1 - v0) * (t - t0) as f64 / (t1 - t0) as f64;
+            assert!((interpolated - v).abs() <= 2.0 * deviation + 1e-12, "{} at {}", v, t);
+        }
+    }
+
+    #[test]
+    fn test_out_of_order_kept() {
+        let mut door = Compressor::new(Mode::SwingingDoor, 1.0, false, 0).unwrap();
+        let points = [(10, 1.0), (20, 1.0), (15, 1.0), (30, 1.0)];
+        assert_eq!(run(&mut door, &points), [(10, 1.0), (20, 1.0), (15, 1.0), (30, 1.0)]);
+    }
+
+    #[test]
+    fn test_rejects_bad_config() {
+        assert!(Compressor::new(Mode::Deadband, -1.0, false, 0).is_err());
+        assert!(Compressor::new(Mode::SwingingDoor, f64::NAN, false, 0).is_err());
+        assert!(Mode::from_code(3).is_err());
+        assert_eq!(Mode::from_code(0), Ok(None));
+    }
+}
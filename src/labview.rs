@@ -0,0 +1,154 @@
+//! LabVIEW native data layouts.
+//!
+//! These let the Call Library Function Node pass arrays and strings as
+//! "Handles by Value" so the library reads LabVIEW's memory in place instead of
+//! LabVIEW copying it out into a C array first.
+//!
+//! A 1D array handle points to a pointer to `{ int32 dimSize; T elt[]; }`; a
+//! string handle (`LStrHandle`) points to a pointer to `{ int32 cnt; uChar str[]; }`.
+//! 32-bit Windows LabVIEW packs these to 1-byte alignment, so `elt` follows
+//! `dimSize` directly. Every other target, including NI Linux RT, pads `elt` to
+//! its natural alignment.
+
+use std::ptr;
+
+/// LabVIEW 1D array block: `{ int32 dimSize; T elt[]; }`
+#[cfg_attr(all(windows, target_pointer_width = "32"), repr(C, packed))]
+#[cfg_attr(not(all(windows, target_pointer_width = "32")), repr(C))]
+pub struct LvArray1D<T> {
+    pub dim_size: i32,
+    elt: [T; 0],
+}
+
+/// LabVIEW 1D array handle (`DBLArrHdl`, `U64ArrHdl`, ...)
+pub type LvArrayHandle<T> = *const *const LvArray1D<T>;
+
+/// LabVIEW string block: `{ int32 cnt; uChar str[]; }`
+#[repr(C)]
+pub struct LStr {
+    pub cnt: i32,
+    str: [u8; 0],
+}
+
+/// LabVIEW string handle
+pub type LStrHandle = *const *const LStr;
+
+/// Borrowed view of a LabVIEW 1D array's elements
+///
+/// Elements are read with unaligned loads so the packed 32-bit Windows layout
+/// is handled without copying; on aligned data this compiles to plain loads.
+#[derive(Clone, Copy)]
+pub struct LvArrayView<T> {
+    data: *const T,
+    len: usize,
+}
+
+impl<T: Copy> LvArrayView<T> {
+    #[inline]
+    pub fn len(&self) -> usize {
+        self.len
+    }
+
+    #[inline]
+    pub fn is_empty(&self) -> bool {
+        self.len == 0
+    }
+
+    /// Iterate over the elements in place
+    #[inline]
+    pub fn iter(&self) -> impl Iterator<Item = T> + '_ {
+        // SAFETY: `data` points to `len` elements for the life of the view
+        (0..self.len).map(move |i| unsafe { ptr::read_unaligned(self.data.add(i)) })
+    }
+}
+
+/// View the elements of a LabVIEW array handle
+///
+/// A null handle, or a handle to a null block, is an empty array (LabVIEW
+/// passes empty arrays that way). A negative `dimSize` is rejected.
+///
+/// # Safety
+/// `handle` must be null or a valid LabVIEW array handle that LabVIEW keeps
+/// alive and does not resize for as long as the view is used.
+pub unsafe fn lv_array<T: Copy>(handle: LvArrayHandle<T>) -> Result<LvArrayView<T>, String> {
+    if handle.is_null() || (*handle).is_null() {
+        return Ok(LvArrayView { data: ptr::null(), len: 0 });
+    }
+    let block = *handle;
+    let dim_size = ptr::read_unaligned(ptr::addr_of!((*block).dim_size));
+    if dim_size < 0 {
+        return Err(format!("Invalid array size: {}", dim_size));
+    }
+    Ok(LvArrayView {
+        data: ptr::addr_of!((*block).elt) as *const T,
+        len: dim_size as usize,
+    })
+}
+
+/// Borrow a LabVIEW string handle as UTF-8
+///
+/// A null handle, or a handle to a null block, is the empty string.
+///
+/// # Safety
+/// `handle` must be null or a valid `LStrHandle` that outlives the result.
+pub unsafe fn lv_str<'a>(handle: LStrHandle) -> Result<&'a str, String> {
+    if handle.is_null() || (*handle).is_null() {
+        return Ok("");
+    }
+    let block = *handle;
+    let cnt = ptr::read_unaligned(ptr::addr_of!((*block).cnt));
+    if cnt < 0 {
+        return Err(format!("Invalid string length: {}", cnt));
+    }
+    let bytes = std::slice::from_raw_parts(ptr::addr_of!((*block).str) as *const u8, cnt as usize);
+    std::str::from_utf8(bytes).map_err(|e| format!("Invalid UTF-8 string: {}", e))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// Build a heap block laid out like a LabVIEW array of `values`
+    fn array_block(values: &[f64]) -> Vec<u64> {
+        let offset = std::mem::size_of::<LvArray1D<f64>>();
+        let mut words = vec![0u64; (offset + values.len() * 8 + 7) / 8];
+        unsafe {
+            let base = words.as_mut_ptr() as *mut u8;
+            ptr::write_unaligned(base as *mut i32, values.len() as i32);
+            for (i, v) in values.iter().enumerate() {
+                ptr::write_unaligned(base.add(offset + i * 8) as *mut f64, *v);
+            }
+        }
+        words
+    }
+
+    #[test]
+    fn test_lv_array() {
+        let block = array_block(&[1.5, 2.5, 3.5]);
+        let block_ptr = block.as_ptr() as *const LvArray1D<f64>;
+        let handle: LvArrayHandle<f64> = &block_ptr;
+
+        let view = unsafe { lv_array(handle) }.unwrap();
+        assert_eq!(view.len(), 3);
+        assert_eq!(view.iter().collect::<Vec<_>>(), vec![1.5, 2.5, 3.5]);
+    }
+
+    #[test]
+    fn test_lv_array_null_is_empty() {
+        let view = unsafe { lv_array::<f64>(ptr::null()) }.unwrap();
+        assert!(view.is_empty());
+        let null_block: *const LvArray1D<f64> = ptr::null();
+        let view = unsafe { lv_array(&null_block) }.unwrap();
+        assert!(view.is_empty());
+    }
+
+    #[test]
+    fn test_lv_str() {
+        let mut block = vec![0u8; 4 + 5];
+        block[..4].copy_from_slice(&5i32.to_ne_bytes());
+        block[4..].copy_from_slice(b"hello");
+        let block_ptr = block.as_ptr() as *const LStr;
+        assert_eq!(unsafe { lv_str(&block_ptr) }.unwrap(), "hello");
+        assert_eq!(unsafe { lv_str(ptr::null()) }.unwrap(), "");
+    }
+}
@@ -1,14 +1,44 @@
 use nominal_streaming::prelude::*;
-use nominal_streaming::stream::{NominalDatasetStream, NominalDatasetStreamBuilder};
+use nominal_streaming::stream::NominalDatasetStreamBuilder;
 use once_cell::sync::Lazy;
-use parking_lot::Mutex;
-use std::collections::HashMap;
 use std::ffi::{CStr, CString};
 use std::os::raw::{c_char, c_int};
+use std::sync::atomic::{AtomicU64, Ordering};
 use std::sync::Arc;
 use std::time::Duration;
 use tokio::runtime::Runtime;
 
+mod channel;
+mod compression;
+mod labview;
+#[doc(hidden)]
+pub mod registry; // public for benches only
+mod ring;
+mod runtime;
+mod scaling;
+mod shutdown;
+mod spool;
+mod stats;
+mod tags;
+mod upload;
+mod stream;
+
+use channel::{Channel, WriterState};
+use compression::Compressor;
+use labview::{lv_array, lv_str, LStrHandle, LvArrayHandle};
+use registry::HandleTable;
+use scaling::{Polynomial, RawSample};
+use stats::ChannelStats;
+use std::collections::HashMap;
+use stream::{ChannelKey, StreamConfig, StreamState};
+use tags::{TagSet, TagTable};
+
+pub use runtime::NominalRuntimeOptions;
+pub use shutdown::NominalShutdownReport;
+pub use stats::{NominalChannelStats, NominalLatencyStats, NominalStreamStats};
+pub use upload::NominalUploadReport;
+pub use stream::{NominalBackpressureCounters, NominalStreamOptions};
+
 // ============================================================================
 // Error Codes
 // ============================================================================
@@ -19,33 +49,57 @@ const ERROR_INVALID_HANDLE: c_int = -2;
 const ERROR_INVALID_PARAM: c_int = -3;
 const ERROR_RUNTIME: c_int = -4;
 const ERROR_IO: c_int = -5;
+const ERROR_QUEUE_FULL: c_int = -6;
 
 // ============================================================================
 // Thread-Local Error Storage
 // ============================================================================
 
+// The message buffer is kept when the error is cleared, so errors raised on
+// the push path can be formatted into it without allocating
+struct LastError {
+    message: String,
+    set: bool,
+}
+
 thread_local! {
-    static LAST_ERROR: std::cell::RefCell<Option<String>> = std::cell::RefCell::new(None);
+    static LAST_ERROR: std::cell::RefCell<LastError> = std::cell::RefCell::new(LastError {
+        message: String::new(),
+        set: false,
+    });
+}
+
+pub(crate) fn set_last_error(err: String) {
+    LAST_ERROR.with(|e| {
+        let mut e = e.borrow_mut();
+        e.message = err;
+        e.set = true;
+    });
 }
 
-fn set_last_error(err: String) {
-    LAST_ERROR.with(|e| *e.borrow_mut() = Some(err));
+/// `set_last_error` that formats into the existing buffer; use on the push path
+pub(crate) fn set_last_error_fmt(args: std::fmt::Arguments) {
+    LAST_ERROR.with(|e| {
+        let mut e = e.borrow_mut();
+        e.message.clear();
+        let _ = std::fmt::Write::write_fmt(&mut e.message, args);
+        e.set = true;
+    });
 }
 
 fn clear_last_error() {
-    LAST_ERROR.with(|e| *e.borrow_mut() = None);
+    LAST_ERROR.with(|e| e.borrow_mut().set = false);
 }
 
 // ============================================================================
 // Global Tokio Runtime
 // ============================================================================
 
-static RUNTIME: Lazy<Runtime> = Lazy::new(|| {
-    tokio::runtime::Builder::new_multi_thread()
-        .worker_threads(4)
-        .enable_all()
-        .build()
-        .expect("Failed to create Tokio runtime")
+// Built on first use from the settings given to nominal_configure_runtime
+pub(crate) static RUNTIME: Lazy<Runtime> = Lazy::new(|| {
+    let runtime = runtime::build();
+    runtime::spawn_driver();
+    runtime
 });
 
 // ============================================================================
@@ -55,37 +109,33 @@ static RUNTIME: Lazy<Runtime> = Lazy::new(|| {
 type StreamHandle = u64;
 type WriterHandle = u64;
 
-// Store streams
-static STREAMS: Lazy<Mutex<HashMap<StreamHandle, Arc<NominalDatasetStream>>>> =
-    Lazy::new(|| Mutex::new(HashMap::new()));
-
-// Store writers along with their stream and descriptor to maintain lifetimes
-// The writer has a lifetime tied to the stream and descriptor
-struct WriterState {
-    stream: Arc<NominalDatasetStream>,
-    descriptor: ChannelDescriptor,
-    // We can't store the writer directly due to lifetime constraints
-    // So we'll recreate it on each push operation
-}
+// Store streams. Handles encode a slot index and generation, see `registry`.
+static STREAMS: Lazy<HandleTable<StreamState>> = Lazy::new(HandleTable::new);
 
-static WRITERS: Lazy<Mutex<HashMap<WriterHandle, Arc<Mutex<WriterState>>>>> =
-    Lazy::new(|| Mutex::new(HashMap::new()));
+// Store channel writers, see `channel`
+static WRITERS: Lazy<HandleTable<Channel>> = Lazy::new(HandleTable::new);
 
-static NEXT_STREAM_HANDLE: Lazy<Mutex<u64>> = Lazy::new(|| Mutex::new(1));
-static NEXT_WRITER_HANDLE: Lazy<Mutex<u64>> = Lazy::new(|| Mutex::new(1));
+// ============================================================================
+// Interleaved Point Layouts
+// ============================================================================
 
-fn allocate_stream_handle() -> StreamHandle {
-    let mut next = NEXT_STREAM_HANDLE.lock();
-    let handle = *next;
-    *next += 1;
-    handle
+/// One point as a `{u64 timestamp_ns; f64 value}` cluster (Push Points Batch_XY)
+///
+/// Packed so arrays from 32-bit LabVIEW, which aligns clusters to 1 byte, can
+/// be read in place; on 64-bit the layout is identical.
+#[repr(C, packed)]
+#[derive(Clone, Copy, Debug)]
+pub struct PointXY {
+    pub timestamp_ns: u64,
+    pub value: f64,
 }
 
-fn allocate_writer_handle() -> WriterHandle {
-    let mut next = NEXT_WRITER_HANDLE.lock();
-    let handle = *next;
-    *next += 1;
-    handle
+/// One point as a `{f64 value; u64 timestamp_ns}` cluster (Push Points Batch_YX)
+#[repr(C, packed)]
+#[derive(Clone, Copy, Debug)]
+pub struct PointYX {
+    pub value: f64,
+    pub timestamp_ns: u64,
 }
 
 // ============================================================================
@@ -103,8 +153,371 @@ unsafe fn c_str_to_string(c_str: *const c_char) -> Result<String, String> {
         .map_err(|e| format!("Invalid UTF-8 string: {}", e))
 }
 
+/// Borrow `count` C strings, naming the first bad one (`what` at index i) in
+/// the last error
+unsafe fn c_str_array<'a>(ptrs: *const *const c_char, count: usize, what: &str) -> Result<Vec<&'a str>, c_int> {
+    if count == 0 {
+        return Ok(Vec::new());
+    }
+    if ptrs.is_null() {
+        set_last_error(format!("Null pointer provided for {} array", what));
+        return Err(ERROR_INVALID_PARAM);
+    }
+    std::slice::from_raw_parts(ptrs, count)
+        .iter()
+        .enumerate()
+        .map(|(i, &ptr)| {
+            if ptr.is_null() {
+                set_last_error(format!("Null {} at index {}", what, i));
+                return Err(ERROR_INVALID_PARAM);
+            }
+            CStr::from_ptr(ptr).to_str().map_err(|e| {
+                set_last_error(format!("Invalid {} at index {}: {}", what, i, e));
+                ERROR_INVALID_PARAM
+            })
+        })
+        .collect()
+}
+
+/// Borrow a LabVIEW array of strings
+unsafe fn lv_str_array<'a>(handle: LvArrayHandle<LStrHandle>, what: &str) -> Result<Vec<&'a str>, String> {
+    lv_array(handle)?
+        .iter()
+        .enumerate()
+        .map(|(i, s)| lv_str(s).map_err(|e| format!("Invalid {} at index {}: {}", what, i, e)))
+        .collect()
+}
+
+/// Look up a writer handle, recording the error if it is invalid
+fn lookup_writer(writer_handle: WriterHandle) -> Result<Arc<Channel>, c_int> {
+    WRITERS.get(writer_handle).ok_or_else(|| {
+        set_last_error_fmt(format_args!("Invalid writer handle: {}", writer_handle));
+        ERROR_INVALID_HANDLE
+    })
+}
+
+/// Push a batch of raw samples, converting and scaling them in chunks
+unsafe fn push_raw_batch<T: RawSample>(
+    writer_handle: WriterHandle,
+    timestamps_ns: *const u64,
+    values: *const T,
+    count: usize,
+) -> c_int {
+    clear_last_error();
+
+    // Validate pointers
+    if timestamps_ns.is_null() || values.is_null() {
+        set_last_error("Null pointer provided for data arrays".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    if count == 0 {
+        return SUCCESS; // Nothing to do
+    }
+
+    // Get writer state
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    let timestamps_slice = std::slice::from_raw_parts(timestamps_ns, count);
+    let values_slice = std::slice::from_raw_parts(values, count);
+
+    let scale = *writer_arc.scale.lock();
+    let result = writer_arc.push_batch(count, |sink| {
+        let mut scaled = [0.0f64; scaling::CHUNK];
+        for (ts_chunk, raw_chunk) in timestamps_slice
+            .chunks(scaling::CHUNK)
+            .zip(values_slice.chunks(scaling::CHUNK))
+        {
+            scaling::convert(raw_chunk, scale.as_ref(), &mut scaled);
+            for (&timestamp, &value) in ts_chunk.iter().zip(&scaled[..raw_chunk.len()]) {
+                sink.push(timestamp, value);
+            }
+        }
+    });
+
+    match result {
+        Ok(()) => SUCCESS,
+        Err(e) => e,
+    }
+}
+
+/// Timestamp of sample `index` of a waveform starting at `t0_ns` with spacing
+/// `dt_ns`. Rounded per sample so fractional periods don't accumulate drift.
+#[inline]
+fn waveform_timestamp(t0_ns: u64, dt_ns: f64, index: usize) -> u64 {
+    t0_ns.wrapping_add((index as f64 * dt_ns).round() as u64)
+}
+
+/// Create a writer for `channel_name` on a stream and register its handle
+fn create_channel(
+    stream_handle: StreamHandle,
+    channel_name: &str,
+    tags_csv: &str,
+) -> Result<WriterHandle, c_int> {
+    // Get stream
+    let stream = match STREAMS.get(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return Err(ERROR_INVALID_HANDLE);
+        }
+    };
+
+    let tags = stream.tags.intern_csv(tags_csv);
+    register_channel(&stream, channel_name, &tags)
+}
+
+/// Find the open channel with this name and tags on a stream, or create it.
+/// Returns the handle and whether it was created.
+fn get_or_create_channel(
+    stream_handle: StreamHandle,
+    channel_name: &str,
+    tags_csv: &str,
+) -> Result<(WriterHandle, bool), c_int> {
+    let stream = match STREAMS.get(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return Err(ERROR_INVALID_HANDLE);
+        }
+    };
+
+    let key = channel_key(&stream, channel_name, &stream.tags.intern_csv(tags_csv));
+    if let Some(handle) = indexed_channel(&stream.channel_index.read(), &key) {
+        return Ok((handle, false));
+    }
+
+    // Create under the write lock so racing callers agree on one channel
+    let mut index = stream.channel_index.write();
+    if let Some(handle) = indexed_channel(&index, &key) {
+        return Ok((handle, false));
+    }
+    let channel = new_channel(&stream, channel_name, key.clone())?;
+    let handle = insert_writer(channel)?;
+    index.insert(key, handle);
+    Ok((handle, true))
+}
+
+/// Index key for a channel on `stream`
+fn channel_key(stream: &StreamState, channel_name: &str, tags: &TagSet) -> ChannelKey {
+    (stream.tags.intern_str(channel_name), tags::merge(&stream.default_tags.read(), tags))
+}
+
+/// Handle indexed under `key`, if that channel is still open
+fn indexed_channel(index: &HashMap<ChannelKey, WriterHandle>, key: &ChannelKey) -> Option<WriterHandle> {
+    index.get(key).copied().filter(|&handle| WRITERS.get(handle).is_some())
+}
+
+/// Index a new channel, unless an open one already has its key
+fn index_channel(index: &mut HashMap<ChannelKey, WriterHandle>, key: ChannelKey, handle: WriterHandle) {
+    if indexed_channel(index, &key).is_none() {
+        index.insert(key, handle);
+    }
+}
+
+/// Drop a closing channel's index entry, if the index still points at it.
+/// Another open channel created with the same key stays unindexed; the next
+/// get-or-create for that key makes a new one.
+fn unindex_channel(index: &mut HashMap<ChannelKey, WriterHandle>, channel: &Channel, handle: WriterHandle) {
+    if index.get(&channel.key) == Some(&handle) {
+        index.remove(&channel.key);
+    }
+}
+
+/// Create a channel on `stream`, give it a handle and index it
+fn register_channel(stream: &Arc<StreamState>, channel_name: &str, tags: &TagSet) -> Result<WriterHandle, c_int> {
+    let key = channel_key(stream, channel_name, tags);
+    let channel = new_channel(stream, channel_name, key.clone())?;
+    let handle = insert_writer(channel)?;
+    index_channel(&mut stream.channel_index.write(), key, handle);
+    Ok(handle)
+}
+
+/// Allocate a handle for a channel
+fn insert_writer(channel: Arc<Channel>) -> Result<WriterHandle, c_int> {
+    WRITERS.insert(channel).ok_or_else(|| {
+        set_last_error("Writer handle table is full".to_string());
+        ERROR_RUNTIME
+    })
+}
+
+/// Validate and intern tags given as parallel key and value arrays
+fn intern_tag_arrays(table: &TagTable, keys: &[&str], values: &[&str]) -> Result<TagSet, c_int> {
+    if keys.len() != values.len() {
+        set_last_error(format!("Array length mismatch: {} tag keys, {} values", keys.len(), values.len()));
+        return Err(ERROR_INVALID_PARAM);
+    }
+    if let Some(i) = keys.iter().position(|k| k.is_empty()) {
+        set_last_error(format!("Invalid tag key at index {}: empty string", i));
+        return Err(ERROR_INVALID_PARAM);
+    }
+    Ok(table.intern(keys.iter().copied().zip(values.iter().copied())))
+}
+
+/// Replace a stream's default tags with the set `tags` builds
+fn set_default_tags(stream_handle: StreamHandle, tags: impl FnOnce(&TagTable) -> Result<TagSet, c_int>) -> c_int {
+    let stream = match STREAMS.get(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return ERROR_INVALID_HANDLE;
+        }
+    };
+    match tags(&stream.tags) {
+        Ok(tags) => {
+            *stream.default_tags.write() = tags;
+            SUCCESS
+        }
+        Err(e) => e,
+    }
+}
+
+/// Create a writer whose tags are given as parallel key and value arrays
+fn create_channel_with_tags(
+    stream_handle: StreamHandle,
+    channel_name: &str,
+    keys: &[&str],
+    values: &[&str],
+) -> Result<WriterHandle, c_int> {
+    let stream = match STREAMS.get(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return Err(ERROR_INVALID_HANDLE);
+        }
+    };
+
+    let tags = intern_tag_arrays(&stream.tags, keys, values)?;
+    register_channel(&stream, channel_name, &tags)
+}
+
+/// Create writers for many channels on a stream and register all of them, or
+/// none if any fails. `tags_csv` holds one CSV per name, or is empty for none.
+/// Names must not be empty.
+fn create_channels(
+    stream_handle: StreamHandle,
+    channel_names: &[&str],
+    tags_csv: &[&str],
+) -> Result<Vec<WriterHandle>, c_int> {
+    let stream = match STREAMS.get(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return Err(ERROR_INVALID_HANDLE);
+        }
+    };
+
+    if !tags_csv.is_empty() && tags_csv.len() != channel_names.len() {
+        set_last_error(format!(
+            "Array length mismatch: {} names, {} tag strings",
+            channel_names.len(),
+            tags_csv.len()
+        ));
+        return Err(ERROR_INVALID_PARAM);
+    }
+    if let Some(i) = channel_names.iter().position(|name| name.is_empty()) {
+        set_last_error(format!("Invalid channel name at index {}: empty or null", i));
+        return Err(ERROR_INVALID_PARAM);
+    }
+
+    // Channels on a rig mostly share their tags, and the stream parses each
+    // distinct CSV only once
+    let mut keys = Vec::with_capacity(channel_names.len());
+    let mut channels = Vec::with_capacity(channel_names.len());
+    for (i, &name) in channel_names.iter().enumerate() {
+        let tags = stream.tags.intern_csv(tags_csv.get(i).copied().unwrap_or(""));
+        let key = channel_key(&stream, name, &tags);
+        match new_channel(&stream, name, key.clone()) {
+            Ok(channel) => channels.push(channel),
+            Err(e) => {
+                channels.iter().for_each(|c| c.close());
+                return Err(e);
+            }
+        }
+        keys.push(key);
+    }
+
+    let handles = WRITERS.insert_all(channels.iter().cloned()).ok_or_else(|| {
+        channels.iter().for_each(|c| c.close());
+        set_last_error(format!("Writer handle table has no room for {} channels", channel_names.len()));
+        ERROR_RUNTIME
+    })?;
+
+    let mut index = stream.channel_index.write();
+    for (key, &handle) in keys.into_iter().zip(&handles) {
+        index_channel(&mut index, key, handle);
+    }
+    Ok(handles)
+}
+
+/// Writer for `channel_name` on a stream, not yet given a handle. The key's
+/// tags already include the stream's defaults, see `channel_key`.
+fn new_channel(stream: &Arc<StreamState>, channel_name: &str, key: ChannelKey) -> Result<Arc<Channel>, c_int> {
+    let resolved = stream.tags.resolve(&key.1);
+    let tags: Vec<(&str, &str)> = resolved.iter().map(|(k, v)| (&**k, &**v)).collect();
+
+    // Create channel descriptor
+    let descriptor = channel::descriptor(channel_name, &tags);
+
+    let mut state = WriterState::new(Arc::clone(&stream.stream), Arc::new(descriptor));
+    if let Some(spool) = &stream.spool {
+        state = state.with_spool(spool.writer(channel_name, &tags));
+    }
+    let channel = Arc::new(Channel::new(Arc::clone(stream), key, state));
+
+    // Streams with a backpressure policy queue every channel through a ring
+    if stream.config.backpressure != stream::Backpressure::None {
+        channel.enable_async(stream.config.queue_capacity)?;
+    }
+    Ok(channel)
+}
+
+/// Open channels that belong to `stream`, with their handles
+fn stream_channels(stream: &Arc<StreamState>) -> Vec<(WriterHandle, Arc<Channel>)> {
+    WRITERS
+        .values()
+        .into_iter()
+        .filter(|(_, channel)| Arc::ptr_eq(&channel.stream, stream))
+        .collect()
+}
+
+/// Flush channels in parallel on the runtime's blocking pool. With a timeout,
+/// wait up to that long for all of them; without one, return immediately.
+fn flush_channels(channels: Vec<Arc<Channel>>, timeout: Option<Duration>) -> c_int {
+    let count = channels.len();
+    let tasks: Vec<_> = channels
+        .into_iter()
+        .map(|channel| RUNTIME.spawn_blocking(move || channel.flush()))
+        .collect();
+
+    let Some(timeout) = timeout else { return SUCCESS };
+    let finished = RUNTIME.block_on(async move {
+        let all = async move {
+            for task in tasks {
+                let _ = task.await;
+            }
+        };
+        tokio::time::timeout(timeout, all).await
+    });
+
+    // Flushes still running when the timeout passes complete in the background
+    if finished.is_err() {
+        set_last_error(format!(
+            "Flush of {} channels did not finish within {} ms",
+            count,
+            timeout.as_millis()
+        ));
+        return ERROR_RUNTIME;
+    }
+    SUCCESS
+}
+
 /// Parse CSV tags into Vec of tuples
-fn parse_tags_csv(tags_csv: &str) -> Vec<(&str, &str)> {
+#[doc(hidden)]
+pub fn parse_tags_csv(tags_csv: &str) -> Vec<(&str, &str)> {
     if tags_csv.is_empty() {
         return Vec::new();
     }
@@ -126,6 +539,59 @@ fn parse_tags_csv(tags_csv: &str) -> Vec<(&str, &str)> {
 // FFI Functions
 // ============================================================================
 
+/// Configure the library's runtime before it starts
+///
+/// Must be called before the first `nominal_init`. Until then it can be
+/// called again, and the last call wins; once the runtime is running this
+/// fails with `ERROR_RUNTIME`. Takes a `NominalRuntimeOptions`:
+///
+/// ```c
+/// typedef struct {
+///     uint64_t struct_size;        // sizeof(NominalRuntimeOptions)
+///     uint64_t worker_threads;     // multi-thread workers (0 = 4)
+///     uint64_t current_thread;     // nonzero = one dedicated thread
+///     uint64_t cpu_affinity_mask;  // bit i = may run on CPU i (0 = any)
+///     uint64_t sched_policy;       // 0 SCHED_OTHER, 1 SCHED_FIFO
+///     int64_t  priority;           // nice (-20..19) or FIFO priority (1..99)
+/// } NominalRuntimeOptions;
+/// ```
+///
+/// Affinity and priority apply to every runtime thread, including the
+/// blocking pool, and are only supported on Linux (NI Linux RT). SCHED_FIFO
+/// and negative nice values need the matching privileges; if a thread can't
+/// apply them, the next `nominal_init` fails with the reason.
+///
+/// # Arguments
+/// * `options` - Runtime options
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_configure_runtime(options: *const NominalRuntimeOptions) -> c_int {
+    clear_last_error();
+
+    if options.is_null() {
+        set_last_error("Options pointer is null".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let config = match NominalRuntimeOptions::read(options).and_then(|o| runtime::RuntimeConfig::from_options(&o)) {
+        Ok(c) => c,
+        Err(e) => {
+            set_last_error(format!("Invalid runtime options: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    match runtime::configure(config) {
+        Ok(()) => SUCCESS,
+        Err(e) => {
+            set_last_error(e);
+            ERROR_RUNTIME
+        }
+    }
+}
+
 /// Initialize a new Nominal stream
 /// 
 /// # Arguments
@@ -145,6 +611,192 @@ pub unsafe extern "C" fn nominal_init(
 ) -> c_int {
     clear_last_error();
 
+    init_stream(
+        token,
+        dataset_rid,
+        fallback_file_path,
+        std::ptr::null(),
+        StreamConfig::default(),
+        out_stream_handle,
+    )
+}
+
+/// Initialize a new Nominal stream with options
+///
+/// Same as `nominal_init`, plus a `NominalStreamOptions` struct:
+///
+/// ```c
+/// typedef struct {
+///     uint64_t struct_size;          // sizeof(NominalStreamOptions)
+///     uint64_t backpressure_policy;  // 0 none, 1 block, 2 drop oldest,
+///                                    // 3 drop newest, 4 spill to file
+///     uint64_t queue_capacity;       // points per channel (0 = 65536)
+///     uint64_t block_timeout_ms;     // wait for policy 1 (0 = 100 ms)
+///     uint64_t max_points_per_request;
+///     uint64_t max_linger_ms;        // longest a partial request waits
+///     uint64_t max_buffered_requests;
+///     uint64_t request_concurrency;  // requests in flight at once
+///     uint64_t spool_segment_bytes;  // see nominal_init_spool (0 = 64 MiB)
+///     uint64_t spool_replay_rate;    // points/s (0 = 100000)
+///     uint64_t spool_max_segments;   // oldest evicted past this (0 = no cap)
+///     uint64_t spool_preallocate;    // 1 = fallocate each segment (Linux)
+/// } NominalStreamOptions;
+/// ```
+///
+/// `max_points_per_request` through `request_concurrency` tune how the
+/// stream batches points into requests; 0 keeps nominal-streaming's default. A short linger keeps latency low for
+/// slow channels, and large requests keep per-request overhead down for fast
+/// ones. Memory held by the stream is roughly `max_points_per_request` x
+/// (`max_buffered_requests` + `request_concurrency`) points.
+///
+/// With a backpressure policy, every channel on the stream pushes through an
+/// async ring of `queue_capacity` points (see `nominal_enable_async`), so memory
+/// held by this library is bounded by channels x capacity. When a channel's
+/// ring is full the policy applies: block up to the timeout then fail with
+/// `ERROR_QUEUE_FULL`, discard the oldest queued points, discard the newest
+/// points, or write the overflow to a spill file next to the fallback file
+/// (`run.avro` -> `run.spill.avro`). Discarded and spilled points are counted,
+/// see `nominal_get_backpressure_counters`.
+///
+/// What a push to a full ring waits for, beyond the bound in
+/// `nominal_enable_async`:
+///
+/// * block - up to `block_timeout_ms`, checking for room every 100 us. Other
+///   threads pushing to the same handle wait behind it.
+/// * drop oldest - for the drain to finish copying at most 1024 points out
+///   of the ring; never for the writer or the stream
+/// * drop newest - nothing
+/// * spill - for the overflow to be appended to the spill file's writer on
+///   the caller's thread, which can block like a synchronous push when the
+///   spill stream's buffers are full
+///
+/// # Arguments
+/// * `token` - Nominal API token (can be null to use env var NOMINAL_TOKEN)
+/// * `dataset_rid` - Dataset RID (e.g., "ri.catalog.main.dataset....")
+/// * `fallback_file_path` - Path for fallback AVRO file (can be null for no fallback)
+/// * `options` - Options struct (can be null for defaults)
+/// * `out_stream_handle` - Output pointer for stream handle
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_init_ex(
+    token: *const c_char,
+    dataset_rid: *const c_char,
+    fallback_file_path: *const c_char,
+    options: *const NominalStreamOptions,
+    out_stream_handle: *mut u64,
+) -> c_int {
+    clear_last_error();
+
+    let config = match read_stream_config(options, fallback_file_path) {
+        Ok(c) => c,
+        Err(e) => return e,
+    };
+
+    init_stream(token, dataset_rid, fallback_file_path, std::ptr::null(), config, out_stream_handle)
+}
+
+/// Initialize a new Nominal stream that spools to local disk first
+///
+/// Same as `nominal_init_ex`, plus a spool directory. Every point handed to
+/// a channel's writer is also appended to a segment file for that channel in
+/// the directory. Points are written to the file by the end of each push
+/// call (each drain chunk in async mode), and each segment is synced to disk
+/// when it reaches `spool_segment_bytes` or the channel is flushed. If the
+/// process dies, segments stay on disk: the next stream opened on the same
+/// directory replays them in the background at `spool_replay_rate` points
+/// per second, alongside live data.
+///
+/// This is not a durability guarantee:
+/// * A segment is deleted once the channel has handed its points to the
+///   stream's buffers, not once Core has accepted them; nominal-streaming
+///   doesn't report that. Points the stream is still holding or uploading
+///   when the process dies are lost unless they reach the fallback file.
+/// * Points in an async channel's ring aren't spooled yet.
+/// * On power loss, points written since the segment was last synced may be
+///   lost too. Flush channels to sync at points that matter.
+///
+/// Disk use is bounded by `spool_max_segments` x `spool_segment_bytes`, plus
+/// one open segment per channel. Past the cap the oldest segments no channel
+/// is writing to are deleted unsent, leftovers first. The stream stats
+/// count them in `spool_segments_evicted`, with the points they held in
+/// `spool_points_evicted` and the span of time lost in
+/// `spool_evicted_first_ns` to `spool_evicted_last_ns`; check these to know
+/// what is missing from the dataset. Opening a spool reads leftover segments
+/// once to find their spans. With `spool_preallocate`, each segment's space
+/// is reserved when it is opened, so a full disk fails the segment up front
+/// instead of mid-write. Current usage is in `nominal_get_stream_stats`.
+///
+/// The cap doesn't cover the fallback file: nominal-streaming appends to it
+/// whenever an upload fails, with no limit of its own.
+///
+/// # Arguments
+/// * `token` - Nominal API token (can be null to use env var NOMINAL_TOKEN)
+/// * `dataset_rid` - Dataset RID (e.g., "ri.catalog.main.dataset....")
+/// * `fallback_file_path` - Path for fallback AVRO file (can be null for no fallback)
+/// * `spool_dir` - Spool directory, created if missing. Give each stream its own.
+/// * `options` - Options struct (can be null for defaults)
+/// * `out_stream_handle` - Output pointer for stream handle
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_init_spool(
+    token: *const c_char,
+    dataset_rid: *const c_char,
+    fallback_file_path: *const c_char,
+    spool_dir: *const c_char,
+    options: *const NominalStreamOptions,
+    out_stream_handle: *mut u64,
+) -> c_int {
+    clear_last_error();
+
+    if spool_dir.is_null() {
+        set_last_error("Spool directory is null".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let config = match read_stream_config(options, fallback_file_path) {
+        Ok(c) => c,
+        Err(e) => return e,
+    };
+
+    init_stream(token, dataset_rid, fallback_file_path, spool_dir, config, out_stream_handle)
+}
+
+/// Resolve `NominalStreamOptions` (null for defaults) into a stream config
+unsafe fn read_stream_config(
+    options: *const NominalStreamOptions,
+    fallback_file_path: *const c_char,
+) -> Result<StreamConfig, c_int> {
+    let config = if options.is_null() {
+        Ok(StreamConfig::default())
+    } else {
+        NominalStreamOptions::read(options).and_then(|o| StreamConfig::from_options(&o))
+    };
+    let config = config.map_err(|e| {
+        set_last_error(format!("Invalid stream options: {}", e));
+        ERROR_INVALID_PARAM
+    })?;
+
+    if config.backpressure == stream::Backpressure::Spill && fallback_file_path.is_null() {
+        set_last_error("Spill backpressure policy requires a fallback file path".to_string());
+        return Err(ERROR_INVALID_PARAM);
+    }
+
+    Ok(config)
+}
+
+/// Build a stream and register its handle
+unsafe fn init_stream(
+    token: *const c_char,
+    dataset_rid: *const c_char,
+    fallback_file_path: *const c_char,
+    spool_dir: *const c_char,
+    config: StreamConfig,
+    out_stream_handle: *mut u64,
+) -> c_int {
     // Validate output pointer
     if out_stream_handle.is_null() {
         set_last_error("Output handle pointer is null".to_string());
@@ -186,82 +838,223 @@ pub unsafe extern "C" fn nominal_init(
         None
     };
 
-    // Build the stream
-    let stream = RUNTIME.block_on(async {
-        let mut builder = NominalDatasetStreamBuilder::new();
-
-        // Determine if we should stream to core
-        let should_stream_to_core = token_str.is_some() || std::env::var("NOMINAL_TOKEN").is_ok();
-
-        if should_stream_to_core {
-            // Get token (from param or env)
-            let token_value = match token_str {
-                Some(t) => t,
-                None => std::env::var("NOMINAL_TOKEN").unwrap(),
-            };
-
-            // Create BearerToken
-            let bearer_token = match BearerToken::new(&token_value) {
-                Ok(t) => t,
-                Err(e) => {
-                    set_last_error(format!("Invalid bearer token: {}", e));
-                    return Err(ERROR_INVALID_PARAM);
-                }
-            };
-
-            // Create ResourceIdentifier
-            let rid = match ResourceIdentifier::new(&dataset_rid_str) {
-                Ok(r) => r,
-                Err(e) => {
-                    set_last_error(format!("Invalid dataset RID: {}", e));
-                    return Err(ERROR_INVALID_PARAM);
-                }
-            };
-
-            // Get current runtime handle
-            let handle = tokio::runtime::Handle::current();
-
-            // Stream to core
-            builder = builder.stream_to_core(bearer_token, rid, handle);
-
-            // Add file fallback if provided
-            if let Some(ref path) = fallback_path_str {
-                builder = builder.with_file_fallback(path);
+    // Parse spool directory
+    let spool_dir_str = if !spool_dir.is_null() {
+        match c_str_to_string(spool_dir) {
+            Ok(s) => Some(s),
+            Err(e) => {
+                set_last_error(format!("Invalid spool directory: {}", e));
+                return ERROR_INVALID_PARAM;
             }
-        } else if let Some(ref path) = fallback_path_str {
-            // No token, just stream to file
-            builder = builder.stream_to_file(path);
-        } else {
-            set_last_error("Either token or fallback file path must be provided".to_string());
-            return Err(ERROR_INVALID_PARAM);
         }
+    } else {
+        None
+    };
 
-        Ok(builder.build())
-    });
+    // Start the runtime, surfacing any affinity/priority failure
+    Lazy::force(&RUNTIME);
+    if let Some(e) = runtime::thread_setup_error() {
+        set_last_error(format!("Runtime thread setup failed: {}", e));
+        return ERROR_RUNTIME;
+    }
 
-    let stream = match stream {
-        Ok(s) => s,
+    // Build the stream
+    let builder = match stream_builder(token_str, &dataset_rid_str, fallback_path_str.as_deref()) {
+        Ok(b) => b,
         Err(e) => return e,
     };
+    let stream = RUNTIME.block_on(async { builder.with_options(config.batching.stream_opts()).build() });
+
+    // Open the spool and replay what earlier runs left in it
+    let spool = match spool_dir_str {
+        Some(dir) => match spool::Spool::open(&dir, config.spool) {
+            Ok(s) => Some(s),
+            Err(e) => {
+                set_last_error(format!("Failed to open spool directory {}: {}", dir, e));
+                return ERROR_IO;
+            }
+        },
+        None => None,
+    };
 
     // Allocate handle and store stream
-    let handle = allocate_stream_handle();
-    STREAMS.lock().insert(handle, Arc::new(stream));
+    let state = StreamState::new(stream, config, fallback_path_str.as_deref(), spool.clone());
+    if let Some(spool) = spool {
+        if let Err(e) = spool.start_replay(Arc::clone(&state.stream)) {
+            set_last_error(format!("Failed to start spool replay: {}", e));
+            return ERROR_IO;
+        }
+    }
+    let handle: StreamHandle = match STREAMS.insert(Arc::new(state)) {
+        Some(h) => h,
+        None => {
+            set_last_error("Stream handle table is full".to_string());
+            return ERROR_RUNTIME;
+        }
+    };
 
     *out_stream_handle = handle;
     SUCCESS
 }
 
-/// Create a channel writer
-/// 
-/// # Arguments
-/// * `stream_handle` - Stream handle from nominal_init
-/// * `channel_name` - Name of the channel
-/// * `tags_csv` - Comma-separated key=value pairs (e.g., "exp=123,sensor=front")
-/// * `out_writer_handle` - Output pointer for writer handle
-/// 
-/// # Returns
-/// 0 on success, negative error code on failure
+/// Stream builder for Core (token from the argument or NOMINAL_TOKEN, with an
+/// optional file fallback), or for a file alone when there is no token
+fn stream_builder(
+    token_str: Option<String>,
+    dataset_rid_str: &str,
+    fallback_path_str: Option<&str>,
+) -> Result<NominalDatasetStreamBuilder, c_int> {
+    let mut builder = NominalDatasetStreamBuilder::new();
+
+    // Determine if we should stream to core
+    let should_stream_to_core = token_str.is_some() || std::env::var("NOMINAL_TOKEN").is_ok();
+
+    if should_stream_to_core {
+        // Get token (from param or env)
+        let token_value = match token_str {
+            Some(t) => t,
+            None => std::env::var("NOMINAL_TOKEN").unwrap(),
+        };
+
+        // Create BearerToken
+        let bearer_token = match BearerToken::new(&token_value) {
+            Ok(t) => t,
+            Err(e) => {
+                set_last_error(format!("Invalid bearer token: {}", e));
+                return Err(ERROR_INVALID_PARAM);
+            }
+        };
+
+        // Create ResourceIdentifier
+        let rid = match ResourceIdentifier::new(dataset_rid_str) {
+            Ok(r) => r,
+            Err(e) => {
+                set_last_error(format!("Invalid dataset RID: {}", e));
+                return Err(ERROR_INVALID_PARAM);
+            }
+        };
+
+        // Stream to core
+        builder = builder.stream_to_core(bearer_token, rid, RUNTIME.handle().clone());
+
+        // Add file fallback if provided
+        if let Some(path) = fallback_path_str {
+            builder = builder.with_file_fallback(path);
+        }
+    } else if let Some(path) = fallback_path_str {
+        // No token, just stream to file
+        builder = builder.stream_to_file(path);
+    } else {
+        set_last_error("Either token or fallback file path must be provided".to_string());
+        return Err(ERROR_INVALID_PARAM);
+    }
+
+    Ok(builder)
+}
+
+/// Set tags for every channel created on a stream from now on
+///
+/// The tags are stored once on the stream and merged into each new channel's
+/// descriptor; a channel's own value for a key replaces the default.
+/// Channels that already exist keep their tags. Calling this again replaces
+/// the defaults; an empty CSV clears them.
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `tags_csv` - Comma-separated key=value pairs (can be null to clear)
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_set_default_tags(stream_handle: u64, tags_csv: *const c_char) -> c_int {
+    clear_last_error();
+
+    let tags_csv_str = if tags_csv.is_null() {
+        ""
+    } else {
+        match CStr::from_ptr(tags_csv).to_str() {
+            Ok(s) => s,
+            Err(e) => {
+                set_last_error(format!("Invalid tags CSV: {}", e));
+                return ERROR_INVALID_PARAM;
+            }
+        }
+    };
+
+    set_default_tags(stream_handle, |table| Ok(table.intern_csv(tags_csv_str)))
+}
+
+/// Set default tags for a stream from key and value arrays
+///
+/// Same as `nominal_set_default_tags`, with tags given as in
+/// `nominal_create_channel_with_tags`. A count of 0 clears the defaults.
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `tag_keys` - Array of `tag_count` tag keys (non-empty)
+/// * `tag_values` - Array of `tag_count` tag values
+/// * `tag_count` - Number of tags
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_set_default_tags_with_tags(
+    stream_handle: u64,
+    tag_keys: *const *const c_char,
+    tag_values: *const *const c_char,
+    tag_count: usize,
+) -> c_int {
+    clear_last_error();
+
+    let (keys, values) = match (
+        c_str_array(tag_keys, tag_count, "tag key"),
+        c_str_array(tag_values, tag_count, "tag value"),
+    ) {
+        (Ok(k), Ok(v)) => (k, v),
+        (Err(e), _) | (_, Err(e)) => return e,
+    };
+
+    set_default_tags(stream_handle, |table| intern_tag_arrays(table, &keys, &values))
+}
+
+/// Set default tags for a stream from LabVIEW key and value string arrays
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `tag_keys` - Array of tag keys (non-empty)
+/// * `tag_values` - Array of tag values, the same length as `tag_keys`
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_set_default_tags_lv(
+    stream_handle: u64,
+    tag_keys: LvArrayHandle<LStrHandle>,
+    tag_values: LvArrayHandle<LStrHandle>,
+) -> c_int {
+    clear_last_error();
+
+    let (keys, values) = match (lv_str_array(tag_keys, "tag key"), lv_str_array(tag_values, "tag value")) {
+        (Ok(k), Ok(v)) => (k, v),
+        (Err(e), _) | (_, Err(e)) => {
+            set_last_error(e);
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    set_default_tags(stream_handle, |table| intern_tag_arrays(table, &keys, &values))
+}
+
+/// Create a channel writer
+/// 
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `channel_name` - Name of the channel
+/// * `tags_csv` - Comma-separated key=value pairs (e.g., "exp=123,sensor=front")
+/// * `out_writer_handle` - Output pointer for writer handle
+/// 
+/// # Returns
+/// 0 on success, negative error code on failure
 #[no_mangle]
 pub unsafe extern "C" fn nominal_create_channel(
     stream_handle: u64,
@@ -277,18 +1070,6 @@ pub unsafe extern "C" fn nominal_create_channel(
         return ERROR_INVALID_PARAM;
     }
 
-    // Get stream
-    let stream = {
-        let streams = STREAMS.lock();
-        match streams.get(&stream_handle) {
-            Some(s) => Arc::clone(s),
-            None => {
-                set_last_error(format!("Invalid stream handle: {}", stream_handle));
-                return ERROR_INVALID_HANDLE;
-            }
-        }
-    };
-
     // Parse channel name
     let channel_name_str = match c_str_to_string(channel_name) {
         Ok(s) => s,
@@ -311,174 +1092,1819 @@ pub unsafe extern "C" fn nominal_create_channel(
         String::new()
     };
 
-    let tags = parse_tags_csv(&tags_csv_str);
+    match create_channel(stream_handle, &channel_name_str, &tags_csv_str) {
+        Ok(handle) => {
+            *out_writer_handle = handle;
+            SUCCESS
+        }
+        Err(e) => e,
+    }
+}
+
+/// Create a channel writer from LabVIEW string handles
+///
+/// Same as `nominal_create_channel`, but takes the name and tags as
+/// `LStrHandle`s so LabVIEW doesn't convert them to C strings.
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `channel_name` - Name of the channel
+/// * `tags_csv` - Comma-separated key=value pairs (can be null or empty)
+/// * `out_writer_handle` - Output pointer for writer handle
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_create_channel_lv(
+    stream_handle: u64,
+    channel_name: LStrHandle,
+    tags_csv: LStrHandle,
+    out_writer_handle: *mut u64,
+) -> c_int {
+    clear_last_error();
 
-    // Create channel descriptor
-    let descriptor = if tags.is_empty() {
-        ChannelDescriptor::new(&channel_name_str)
-    } else {
-        ChannelDescriptor::with_tags(&channel_name_str, tags)
+    // Validate output pointer
+    if out_writer_handle.is_null() {
+        set_last_error("Output handle pointer is null".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let channel_name_str = match lv_str(channel_name) {
+        Ok(s) if !s.is_empty() => s,
+        Ok(_) => {
+            set_last_error("Invalid channel name: empty string".to_string());
+            return ERROR_INVALID_PARAM;
+        }
+        Err(e) => {
+            set_last_error(format!("Invalid channel name: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
     };
 
-    // Allocate handle and store writer state
-    // We store the stream and descriptor, and create the writer on-demand
-    let handle = allocate_writer_handle();
-    let state = WriterState {
-        stream: Arc::clone(&stream),
-        descriptor,
+    let tags_csv_str = match lv_str(tags_csv) {
+        Ok(s) => s,
+        Err(e) => {
+            set_last_error(format!("Invalid tags CSV: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
     };
-    WRITERS.lock().insert(handle, Arc::new(Mutex::new(state)));
 
-    *out_writer_handle = handle;
-    SUCCESS
+    match create_channel(stream_handle, channel_name_str, tags_csv_str) {
+        Ok(handle) => {
+            *out_writer_handle = handle;
+            SUCCESS
+        }
+        Err(e) => e,
+    }
 }
 
-/// Push a batch of double data points
-/// 
+/// Get the open channel writer with this name and tags, or create it
+///
+/// Lets independent parts of a LabVIEW program share one writer per signal
+/// without passing the handle between them. The lookup is keyed by the name
+/// and the tags merged with the stream's default tags, so tag order and
+/// repeated CSVs don't matter. Channels made by the other create functions
+/// are found too.
+///
+/// The handle is shared: closing it closes the channel for every caller
+/// holding it. The next call with the same name and tags then creates a new
+/// channel.
+///
 /// # Arguments
-/// * `writer_handle` - Writer handle from nominal_create_channel
-/// * `timestamps_ns` - Array of timestamps in nanoseconds since Unix epoch
-/// * `values` - Array of double values
-/// * `count` - Number of points in the arrays
-/// 
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `channel_name` - Name of the channel
+/// * `tags_csv` - Comma-separated key=value pairs (can be null)
+/// * `out_writer_handle` - Output pointer for writer handle
+/// * `out_created` - Set to 1 if the channel was created, 0 if it already
+///   existed (can be null)
+///
 /// # Returns
 /// 0 on success, negative error code on failure
 #[no_mangle]
-pub unsafe extern "C" fn nominal_push_double_batch(
-    writer_handle: u64,
-    timestamps_ns: *const u64,
-    values: *const f64,
-    count: usize,
+pub unsafe extern "C" fn nominal_get_or_create_channel(
+    stream_handle: u64,
+    channel_name: *const c_char,
+    tags_csv: *const c_char,
+    out_writer_handle: *mut u64,
+    out_created: *mut u32,
 ) -> c_int {
     clear_last_error();
 
-    // Validate pointers
-    if timestamps_ns.is_null() || values.is_null() {
-        set_last_error("Null pointer provided for data arrays".to_string());
+    if out_writer_handle.is_null() {
+        set_last_error("Output handle pointer is null".to_string());
         return ERROR_INVALID_PARAM;
     }
 
-    if count == 0 {
-        return SUCCESS; // Nothing to do
-    }
+    let channel_name_str = match c_str_to_string(channel_name) {
+        Ok(s) => s,
+        Err(e) => {
+            set_last_error(format!("Invalid channel name: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
+    };
 
-    // Get writer state
-    let writer_arc = {
-        let writers = WRITERS.lock();
-        match writers.get(&writer_handle) {
-            Some(w) => Arc::clone(w),
-            None => {
-                set_last_error(format!("Invalid writer handle: {}", writer_handle));
-                return ERROR_INVALID_HANDLE;
+    let tags_csv_str = if !tags_csv.is_null() {
+        match c_str_to_string(tags_csv) {
+            Ok(s) => s,
+            Err(e) => {
+                set_last_error(format!("Invalid tags CSV: {}", e));
+                return ERROR_INVALID_PARAM;
             }
         }
+    } else {
+        String::new()
     };
 
-    // Convert arrays to slices
-    let timestamps_slice = std::slice::from_raw_parts(timestamps_ns, count);
-    let values_slice = std::slice::from_raw_parts(values, count);
-
-    // Get the writer state and push each point
-    let state_guard = writer_arc.lock();
-    let mut writer = state_guard.stream.double_writer(&state_guard.descriptor);
-    
-    for i in 0..count {
-        let timestamp = Duration::from_nanos(timestamps_slice[i]);
-        let value = values_slice[i];
-        writer.push(timestamp, value);
+    match get_or_create_channel(stream_handle, &channel_name_str, &tags_csv_str) {
+        Ok((handle, created)) => {
+            *out_writer_handle = handle;
+            if !out_created.is_null() {
+                *out_created = created as u32;
+            }
+            SUCCESS
+        }
+        Err(e) => e,
     }
-
-    SUCCESS
 }
 
-/// Close a channel writer and flush remaining data
-/// 
+/// Get or create a channel writer from LabVIEW string handles
+///
+/// Same as `nominal_get_or_create_channel`, but takes the name and tags as
+/// `LStrHandle`s.
+///
 /// # Arguments
-/// * `writer_handle` - Writer handle from nominal_create_channel
-/// 
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `channel_name` - Name of the channel
+/// * `tags_csv` - Comma-separated key=value pairs (can be null or empty)
+/// * `out_writer_handle` - Output pointer for writer handle
+/// * `out_created` - Set to 1 if the channel was created, 0 if it already
+///   existed (can be null)
+///
 /// # Returns
 /// 0 on success, negative error code on failure
 #[no_mangle]
-pub unsafe extern "C" fn nominal_close_channel(writer_handle: u64) -> c_int {
+pub unsafe extern "C" fn nominal_get_or_create_channel_lv(
+    stream_handle: u64,
+    channel_name: LStrHandle,
+    tags_csv: LStrHandle,
+    out_writer_handle: *mut u64,
+    out_created: *mut u32,
+) -> c_int {
     clear_last_error();
 
-    // Remove writer from registry
-    let writer_arc = {
-        let mut writers = WRITERS.lock();
-        match writers.remove(&writer_handle) {
-            Some(w) => w,
-            None => {
-                set_last_error(format!("Invalid writer handle: {}", writer_handle));
-                return ERROR_INVALID_HANDLE;
-            }
+    if out_writer_handle.is_null() {
+        set_last_error("Output handle pointer is null".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let channel_name_str = match lv_str(channel_name) {
+        Ok(s) if !s.is_empty() => s,
+        Ok(_) => {
+            set_last_error("Invalid channel name: empty string".to_string());
+            return ERROR_INVALID_PARAM;
+        }
+        Err(e) => {
+            set_last_error(format!("Invalid channel name: {}", e));
+            return ERROR_INVALID_PARAM;
         }
     };
 
-    // Drop the writer - this should trigger any cleanup
-    drop(writer_arc);
+    let tags_csv_str = match lv_str(tags_csv) {
+        Ok(s) => s,
+        Err(e) => {
+            set_last_error(format!("Invalid tags CSV: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
+    };
 
-    SUCCESS
+    match get_or_create_channel(stream_handle, channel_name_str, tags_csv_str) {
+        Ok((handle, created)) => {
+            *out_writer_handle = handle;
+            if !out_created.is_null() {
+                *out_created = created as u32;
+            }
+            SUCCESS
+        }
+        Err(e) => e,
+    }
 }
 
-/// Shutdown stream and cleanup resources
-/// 
+/// Create a channel writer with tags as key and value arrays
+///
+/// Same as `nominal_create_channel`, but without a CSV to build and parse.
+/// Keys and values may contain `,` and `=`. Tag strings are interned per
+/// stream, so channels that share tags share one copy of each string in the
+/// library. A repeated key keeps its last value.
+///
 /// # Arguments
 /// * `stream_handle` - Stream handle from nominal_init
-/// 
+/// * `channel_name` - Name of the channel
+/// * `tag_keys` - Array of `tag_count` tag keys (non-empty)
+/// * `tag_values` - Array of `tag_count` tag values
+/// * `tag_count` - Number of tags (can be 0, with null arrays)
+/// * `out_writer_handle` - Output pointer for writer handle
+///
 /// # Returns
 /// 0 on success, negative error code on failure
 #[no_mangle]
-pub unsafe extern "C" fn nominal_shutdown(stream_handle: u64) -> c_int {
+pub unsafe extern "C" fn nominal_create_channel_with_tags(
+    stream_handle: u64,
+    channel_name: *const c_char,
+    tag_keys: *const *const c_char,
+    tag_values: *const *const c_char,
+    tag_count: usize,
+    out_writer_handle: *mut u64,
+) -> c_int {
     clear_last_error();
 
-    // Remove stream from registry
-    let _stream = {
-        let mut streams = STREAMS.lock();
-        match streams.remove(&stream_handle) {
-            Some(s) => s,
-            None => {
-                set_last_error(format!("Invalid stream handle: {}", stream_handle));
-                return ERROR_INVALID_HANDLE;
-            }
+    if out_writer_handle.is_null() {
+        set_last_error("Output handle pointer is null".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let channel_name_str = match c_str_to_string(channel_name) {
+        Ok(s) => s,
+        Err(e) => {
+            set_last_error(format!("Invalid channel name: {}", e));
+            return ERROR_INVALID_PARAM;
         }
     };
 
-    // Stream will be dropped here, triggering cleanup
-    SUCCESS
+    let (keys, values) = match (
+        c_str_array(tag_keys, tag_count, "tag key"),
+        c_str_array(tag_values, tag_count, "tag value"),
+    ) {
+        (Ok(k), Ok(v)) => (k, v),
+        (Err(e), _) | (_, Err(e)) => return e,
+    };
+
+    match create_channel_with_tags(stream_handle, &channel_name_str, &keys, &values) {
+        Ok(handle) => {
+            *out_writer_handle = handle;
+            SUCCESS
+        }
+        Err(e) => e,
+    }
 }
 
-/// Get the last error message
-/// 
+/// Create a channel writer with tags as LabVIEW key and value string arrays
+///
+/// Same as `nominal_create_channel_with_tags`, but takes the name as an
+/// `LStrHandle` and the tags as LabVIEW arrays of strings.
+///
 /// # Arguments
-/// * `buffer` - Output buffer for error message
-/// * `buffer_size` - Size of the buffer
-/// 
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `channel_name` - Name of the channel
+/// * `tag_keys` - Array of tag keys (non-empty)
+/// * `tag_values` - Array of tag values, the same length as `tag_keys`
+/// * `out_writer_handle` - Output pointer for writer handle
+///
 /// # Returns
-/// 0 on success, negative error code if no error or buffer too small
-
+/// 0 on success, negative error code on failure
 #[no_mangle]
-pub extern "C" fn nominal_get_last_error(
-    buffer: *mut c_char,
-    buffer_size: usize,
-) -> i32 {
-    if buffer.is_null() || buffer_size == 0 {
-        return -3;
+pub unsafe extern "C" fn nominal_create_channel_with_tags_lv(
+    stream_handle: u64,
+    channel_name: LStrHandle,
+    tag_keys: LvArrayHandle<LStrHandle>,
+    tag_values: LvArrayHandle<LStrHandle>,
+    out_writer_handle: *mut u64,
+) -> c_int {
+    clear_last_error();
+
+    if out_writer_handle.is_null() {
+        set_last_error("Output handle pointer is null".to_string());
+        return ERROR_INVALID_PARAM;
     }
 
-    LAST_ERROR.with(|last_error| {
-        let error_msg = last_error.borrow();
-        
-        // Handle Option<String>
-        let msg = match error_msg.as_ref() {
-            Some(s) => s,
-            None => {
-                // No error stored, write empty string
-                unsafe {
-                    *buffer = 0;
-                }
-                return -1;
-            }
-        };
+    let channel_name_str = match lv_str(channel_name) {
+        Ok(s) if !s.is_empty() => s,
+        Ok(_) => {
+            set_last_error("Invalid channel name: empty string".to_string());
+            return ERROR_INVALID_PARAM;
+        }
+        Err(e) => {
+            set_last_error(format!("Invalid channel name: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    let (keys, values) = match (lv_str_array(tag_keys, "tag key"), lv_str_array(tag_values, "tag value")) {
+        (Ok(k), Ok(v)) => (k, v),
+        (Err(e), _) | (_, Err(e)) => {
+            set_last_error(e);
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    match create_channel_with_tags(stream_handle, channel_name_str, &keys, &values) {
+        Ok(handle) => {
+            *out_writer_handle = handle;
+            SUCCESS
+        }
+        Err(e) => e,
+    }
+}
+
+/// Create writers for many channels in one call
+///
+/// Every name and tag string is validated before any channel is created,
+/// each distinct tags CSV is parsed once, and the handles are registered
+/// together. Either every channel is created or none is. Empty or null names
+/// are rejected with `ERROR_INVALID_PARAM`; a `count` of 0 creates nothing.
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `channel_names` - Array of `count` channel names
+/// * `tags_csv` - Array of `count` tag CSVs, one per channel (can be null for
+///   no tags; null entries mean no tags for that channel)
+/// * `count` - Number of channels
+/// * `out_writer_handles` - Output array of `count` writer handles, in order
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_create_channels(
+    stream_handle: u64,
+    channel_names: *const *const c_char,
+    tags_csv: *const *const c_char,
+    count: usize,
+    out_writer_handles: *mut u64,
+) -> c_int {
+    clear_last_error();
+
+    if channel_names.is_null() || out_writer_handles.is_null() {
+        set_last_error("Null pointer provided for name or handle array".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let borrow = |ptr: *const c_char, what: &str, i: usize| -> Result<&str, c_int> {
+        if ptr.is_null() {
+            return Ok("");
+        }
+        CStr::from_ptr(ptr).to_str().map_err(|e| {
+            set_last_error(format!("Invalid {} at index {}: {}", what, i, e));
+            ERROR_INVALID_PARAM
+        })
+    };
+
+    let name_ptrs = std::slice::from_raw_parts(channel_names, count);
+    let mut names = Vec::with_capacity(count);
+    for (i, &ptr) in name_ptrs.iter().enumerate() {
+        match borrow(ptr, "channel name", i) {
+            Ok(name) => names.push(name),
+            Err(e) => return e,
+        }
+    }
+
+    let mut tags = Vec::new();
+    if !tags_csv.is_null() {
+        tags.reserve(count);
+        for (i, &ptr) in std::slice::from_raw_parts(tags_csv, count).iter().enumerate() {
+            match borrow(ptr, "tags CSV", i) {
+                Ok(csv) => tags.push(csv),
+                Err(e) => return e,
+            }
+        }
+    }
+
+    match create_channels(stream_handle, &names, &tags) {
+        Ok(handles) => {
+            std::ptr::copy_nonoverlapping(handles.as_ptr(), out_writer_handles, count);
+            SUCCESS
+        }
+        Err(e) => e,
+    }
+}
+
+/// Create writers for many channels from LabVIEW string arrays
+///
+/// Same as `nominal_create_channels`, but takes the names and tags as
+/// LabVIEW arrays of strings, passed as handles by value. Size the output
+/// array to at least the number of names, for example with Initialize
+/// Array; if it is smaller, nothing is created and `ERROR_INVALID_PARAM` is
+/// returned.
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `channel_names` - Array of channel names
+/// * `tags_csv` - Array of tag CSVs, one per channel, or empty for no tags
+/// * `out_writer_handles` - Output array of handles, in order (array data
+///   pointer)
+/// * `out_capacity` - Number of elements in `out_writer_handles`
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_create_channels_lv(
+    stream_handle: u64,
+    channel_names: LvArrayHandle<LStrHandle>,
+    tags_csv: LvArrayHandle<LStrHandle>,
+    out_writer_handles: *mut u64,
+    out_capacity: usize,
+) -> c_int {
+    clear_last_error();
+
+    if out_writer_handles.is_null() {
+        set_last_error("Output handle array is null".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let (names_view, tags_view) = match (lv_array(channel_names), lv_array(tags_csv)) {
+        (Ok(n), Ok(t)) => (n, t),
+        (Err(e), _) | (_, Err(e)) => {
+            set_last_error(format!("Invalid string array: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    if names_view.len() > out_capacity {
+        set_last_error(format!(
+            "Output handle array too small: {} names, room for {}",
+            names_view.len(),
+            out_capacity
+        ));
+        return ERROR_INVALID_PARAM;
+    }
+
+    let mut names = Vec::with_capacity(names_view.len());
+    for (i, handle) in names_view.iter().enumerate() {
+        match lv_str(handle) {
+            Ok(name) => names.push(name),
+            Err(e) => {
+                set_last_error(format!("Invalid channel name at index {}: {}", i, e));
+                return ERROR_INVALID_PARAM;
+            }
+        }
+    }
+
+    let mut tags = Vec::with_capacity(tags_view.len());
+    for (i, handle) in tags_view.iter().enumerate() {
+        match lv_str(handle) {
+            Ok(csv) => tags.push(csv),
+            Err(e) => {
+                set_last_error(format!("Invalid tags CSV at index {}: {}", i, e));
+                return ERROR_INVALID_PARAM;
+            }
+        }
+    }
+
+    match create_channels(stream_handle, &names, &tags) {
+        Ok(handles) => {
+            std::ptr::copy_nonoverlapping(handles.as_ptr(), out_writer_handles, handles.len());
+            SUCCESS
+        }
+        Err(e) => e,
+    }
+}
+
+/// Push a batch of double data points
+///
+/// Only async channels push without allocating; see `nominal_enable_async`.
+/// On a synchronous channel the points go into nominal-streaming's writer,
+/// which allocates as its buffers fill and are handed to the stream.
+/// 
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `timestamps_ns` - Array of timestamps in nanoseconds since Unix epoch
+/// * `values` - Array of double values
+/// * `count` - Number of points in the arrays
+/// 
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_double_batch(
+    writer_handle: u64,
+    timestamps_ns: *const u64,
+    values: *const f64,
+    count: usize,
+) -> c_int {
+    clear_last_error();
+
+    // Validate pointers
+    if timestamps_ns.is_null() || values.is_null() {
+        set_last_error("Null pointer provided for data arrays".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    if count == 0 {
+        return SUCCESS; // Nothing to do
+    }
+
+    // Get writer state
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    // Convert arrays to slices
+    let timestamps_slice = std::slice::from_raw_parts(timestamps_ns, count);
+    let values_slice = std::slice::from_raw_parts(values, count);
+
+    // Append into the channel's long-lived writer
+    let result = writer_arc.push_batch(count, |sink| {
+        for (&timestamp, &value) in timestamps_slice.iter().zip(values_slice) {
+            sink.push(timestamp, value);
+        }
+    });
+
+    match result {
+        Ok(()) => SUCCESS,
+        Err(e) => e,
+    }
+}
+
+/// Set the polynomial scale applied to a channel's raw pushes
+///
+/// Raw samples `x` pushed through the typed entry points (`nominal_push_f32_batch`,
+/// `nominal_push_i16_batch`, ...) are stored as `c0 + c1*x + c2*x^2 + ...`.
+/// A gain/offset is `[offset, gain]`. Double pushes are never scaled.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `coefficients` - Array of coefficients, lowest order first (null to clear)
+/// * `count` - Number of coefficients, 1 to 8 (0 to clear)
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_set_channel_scale(
+    writer_handle: u64,
+    coefficients: *const f64,
+    count: usize,
+) -> c_int {
+    clear_last_error();
+
+    let scale = if coefficients.is_null() || count == 0 {
+        None
+    } else if count > scaling::MAX_COEFFICIENTS {
+        set_last_error(format!(
+            "Scale must have 1 to {} coefficients, got {}",
+            scaling::MAX_COEFFICIENTS,
+            count
+        ));
+        return ERROR_INVALID_PARAM;
+    } else {
+        match Polynomial::new(std::slice::from_raw_parts(coefficients, count)) {
+            Ok(p) => Some(p),
+            Err(e) => {
+                set_last_error(e);
+                return ERROR_INVALID_PARAM;
+            }
+        }
+    };
+
+    // Get writer state
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    *writer_arc.scale.lock() = scale;
+    SUCCESS
+}
+
+/// Set or clear a channel's compression
+///
+/// Points pushed to the channel from then on, by any push function, pass
+/// through a compression stage first, and only the points it keeps count as
+/// accepted and go to the stream. Modes:
+///
+/// * 0 - off
+/// * 1 - deadband: keep a point when it differs from the last kept value by
+///   more than `deviation`
+/// * 2 - swinging door: keep a point once no straight line from the last kept
+///   point passes within `deviation` of every point since. Linear
+///   interpolation between kept points is then within twice `deviation` of
+///   every dropped point. The newest point is held back until a later point,
+///   a flush or a close decides it.
+///
+/// Non-finite values and timestamps that don't increase are always kept.
+/// A push that fails, for example with `ERROR_QUEUE_FULL`, leaves compression
+/// as it was, so the batch can be retried. Changing the setting restarts
+/// compression from the next point, after pushing any point the old setting
+/// held back.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `mode` - Compression mode, see above
+/// * `deviation` - Allowed deviation in the channel's units, or in percent
+///   of the magnitude of the last kept value
+/// * `deviation_is_percent` - Non-zero if `deviation` is a percentage
+/// * `max_interval_ns` - Keep a point whenever none has been kept for this
+///   long (0 for no limit)
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_set_channel_compression(
+    writer_handle: u64,
+    mode: u32,
+    deviation: f64,
+    deviation_is_percent: u32,
+    max_interval_ns: u64,
+) -> c_int {
+    clear_last_error();
+
+    let compressor = match compression::Mode::from_code(mode) {
+        Ok(None) => None,
+        Ok(Some(mode)) => match Compressor::new(mode, deviation, deviation_is_percent != 0, max_interval_ns) {
+            Ok(c) => Some(c),
+            Err(e) => {
+                set_last_error(e);
+                return ERROR_INVALID_PARAM;
+            }
+        },
+        Err(e) => {
+            set_last_error(e);
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    match writer_arc.set_compression(compressor) {
+        Ok(()) => SUCCESS,
+        Err(e) => e,
+    }
+}
+
+/// Push a batch of single-precision float samples
+///
+/// Samples are converted to double in the library, applying the channel's
+/// scale if one was set with `nominal_set_channel_scale`.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `timestamps_ns` - Array of timestamps in nanoseconds since Unix epoch
+/// * `values` - Array of `f32` samples
+/// * `count` - Number of points in the arrays
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_f32_batch(
+    writer_handle: u64,
+    timestamps_ns: *const u64,
+    values: *const f32,
+    count: usize,
+) -> c_int {
+    push_raw_batch(writer_handle, timestamps_ns, values, count)
+}
+
+/// Push a batch of signed 16-bit samples
+///
+/// Samples are converted to double in the library, applying the channel's
+/// scale if one was set with `nominal_set_channel_scale`.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `timestamps_ns` - Array of timestamps in nanoseconds since Unix epoch
+/// * `values` - Array of `i16` samples
+/// * `count` - Number of points in the arrays
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_i16_batch(
+    writer_handle: u64,
+    timestamps_ns: *const u64,
+    values: *const i16,
+    count: usize,
+) -> c_int {
+    push_raw_batch(writer_handle, timestamps_ns, values, count)
+}
+
+/// Push a batch of unsigned 16-bit samples
+///
+/// Samples are converted to double in the library, applying the channel's
+/// scale if one was set with `nominal_set_channel_scale`.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `timestamps_ns` - Array of timestamps in nanoseconds since Unix epoch
+/// * `values` - Array of `u16` samples
+/// * `count` - Number of points in the arrays
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_u16_batch(
+    writer_handle: u64,
+    timestamps_ns: *const u64,
+    values: *const u16,
+    count: usize,
+) -> c_int {
+    push_raw_batch(writer_handle, timestamps_ns, values, count)
+}
+
+/// Push a batch of signed 32-bit samples
+///
+/// Samples are converted to double in the library, applying the channel's
+/// scale if one was set with `nominal_set_channel_scale`.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `timestamps_ns` - Array of timestamps in nanoseconds since Unix epoch
+/// * `values` - Array of `i32` samples
+/// * `count` - Number of points in the arrays
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_i32_batch(
+    writer_handle: u64,
+    timestamps_ns: *const u64,
+    values: *const i32,
+    count: usize,
+) -> c_int {
+    push_raw_batch(writer_handle, timestamps_ns, values, count)
+}
+
+/// Push a batch of signed 64-bit samples
+///
+/// Samples are converted to double in the library, applying the channel's
+/// scale if one was set with `nominal_set_channel_scale`.
+///
+/// Magnitudes above 2^53 lose precision when converted to double.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `timestamps_ns` - Array of timestamps in nanoseconds since Unix epoch
+/// * `values` - Array of `i64` samples
+/// * `count` - Number of points in the arrays
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_i64_batch(
+    writer_handle: u64,
+    timestamps_ns: *const u64,
+    values: *const i64,
+    count: usize,
+) -> c_int {
+    push_raw_batch(writer_handle, timestamps_ns, values, count)
+}
+
+/// Push a uniformly sampled waveform, generating timestamps in the library
+///
+/// Sample `i` is stamped `t0_ns + round(i * dt_ns)`, so LabVIEW never has to
+/// build a timestamp array for waveform data.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `t0_ns` - Timestamp of the first sample in nanoseconds since Unix epoch
+/// * `dt_ns` - Sample interval in nanoseconds (fractional intervals allowed)
+/// * `values` - Array of double values (the waveform Y array)
+/// * `count` - Number of samples in the array
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_waveform(
+    writer_handle: u64,
+    t0_ns: u64,
+    dt_ns: f64,
+    values: *const f64,
+    count: usize,
+) -> c_int {
+    clear_last_error();
+
+    // Validate pointers
+    if values.is_null() {
+        set_last_error("Null pointer provided for data array".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    if !dt_ns.is_finite() || dt_ns < 0.0 {
+        set_last_error(format!("Invalid sample interval: {} ns", dt_ns));
+        return ERROR_INVALID_PARAM;
+    }
+
+    if count == 0 {
+        return SUCCESS; // Nothing to do
+    }
+
+    // Get writer state
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    let values_slice = std::slice::from_raw_parts(values, count);
+
+    let result = writer_arc.push_batch(count, |sink| {
+        for (i, &value) in values_slice.iter().enumerate() {
+            sink.push(waveform_timestamp(t0_ns, dt_ns, i), value);
+        }
+    });
+
+    match result {
+        Ok(()) => SUCCESS,
+        Err(e) => e,
+    }
+}
+
+/// Push a batch of double data points from LabVIEW array handles
+///
+/// Same as `nominal_push_double_batch`, but reads LabVIEW's `U64` and `DBL`
+/// array handles in place, so LabVIEW doesn't copy them out for the call.
+/// Both arrays must have the same length.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `timestamps_ns` - `U64` array handle of timestamps in nanoseconds since Unix epoch
+/// * `values` - `DBL` array handle of values
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_double_batch_lv(
+    writer_handle: u64,
+    timestamps_ns: LvArrayHandle<u64>,
+    values: LvArrayHandle<f64>,
+) -> c_int {
+    clear_last_error();
+
+    let (timestamps_view, values_view) = match (lv_array(timestamps_ns), lv_array(values)) {
+        (Ok(t), Ok(v)) => (t, v),
+        (Err(e), _) | (_, Err(e)) => {
+            set_last_error(format!("Invalid data array: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    if timestamps_view.len() != values_view.len() {
+        set_last_error(format!(
+            "Array length mismatch: {} timestamps, {} values",
+            timestamps_view.len(),
+            values_view.len()
+        ));
+        return ERROR_INVALID_PARAM;
+    }
+
+    if values_view.is_empty() {
+        return SUCCESS; // Nothing to do
+    }
+
+    // Get writer state
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    let result = writer_arc.push_batch(values_view.len(), |sink| {
+        for (timestamp, value) in timestamps_view.iter().zip(values_view.iter()) {
+            sink.push(timestamp, value);
+        }
+    });
+
+    match result {
+        Ok(()) => SUCCESS,
+        Err(e) => e,
+    }
+}
+
+/// Push a uniformly sampled waveform from a LabVIEW `DBL` array handle
+///
+/// Same as `nominal_push_waveform`, but reads the Y array in place.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `t0_ns` - Timestamp of the first sample in nanoseconds since Unix epoch
+/// * `dt_ns` - Sample interval in nanoseconds (fractional intervals allowed)
+/// * `values` - `DBL` array handle of the waveform Y array
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_waveform_lv(
+    writer_handle: u64,
+    t0_ns: u64,
+    dt_ns: f64,
+    values: LvArrayHandle<f64>,
+) -> c_int {
+    clear_last_error();
+
+    let values_view = match lv_array(values) {
+        Ok(v) => v,
+        Err(e) => {
+            set_last_error(format!("Invalid data array: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    if !dt_ns.is_finite() || dt_ns < 0.0 {
+        set_last_error(format!("Invalid sample interval: {} ns", dt_ns));
+        return ERROR_INVALID_PARAM;
+    }
+
+    if values_view.is_empty() {
+        return SUCCESS; // Nothing to do
+    }
+
+    // Get writer state
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    let result = writer_arc.push_batch(values_view.len(), |sink| {
+        for (i, value) in values_view.iter().enumerate() {
+            sink.push(waveform_timestamp(t0_ns, dt_ns, i), value);
+        }
+    });
+
+    match result {
+        Ok(()) => SUCCESS,
+        Err(e) => e,
+    }
+}
+
+/// Push one acquisition of several channels sharing a timestamp vector
+///
+/// `values` is a row-major `n_channels x n_samples` matrix (one row per
+/// channel, as returned by a DAQmx 2D DBL read). Every handle is resolved
+/// before anything is pushed, so an invalid handle leaves all channels
+/// untouched. Each handle may appear only once: a second row for the same
+/// channel would restart at the first timestamp and go back in time.
+///
+/// # Arguments
+/// * `writer_handles` - Array of `n_channels` writer handles, one per row
+/// * `n_channels` - Number of rows in `values`
+/// * `timestamps_ns` - Array of `n_samples` timestamps shared by every row
+/// * `values` - Row-major matrix of `n_channels * n_samples` doubles
+/// * `n_samples` - Number of columns in `values`
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_multi_double_batch(
+    writer_handles: *const u64,
+    n_channels: usize,
+    timestamps_ns: *const u64,
+    values: *const f64,
+    n_samples: usize,
+) -> c_int {
+    clear_last_error();
+
+    // Validate pointers
+    if writer_handles.is_null() || timestamps_ns.is_null() || values.is_null() {
+        set_last_error("Null pointer provided for data arrays".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let total = match n_channels.checked_mul(n_samples) {
+        Some(t) => t,
+        None => {
+            set_last_error("Channel and sample counts overflow".to_string());
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    if total == 0 {
+        return SUCCESS; // Nothing to do
+    }
+
+    let handles = std::slice::from_raw_parts(writer_handles, n_channels);
+    let timestamps_slice = std::slice::from_raw_parts(timestamps_ns, n_samples);
+    let values_slice = std::slice::from_raw_parts(values, total);
+
+    MULTI_PUSH_SCRATCH.with(|scratch| {
+        let scratch = &mut *scratch.borrow_mut();
+        let status = push_rows(scratch, handles, timestamps_slice, values_slice);
+        // Release the channels but keep the capacity for the next call
+        scratch.writers.clear();
+        status
+    })
+}
+
+// Reused by nominal_push_multi_double_batch so steady-state calls don't allocate
+#[derive(Default)]
+struct MultiPushScratch {
+    rows: Vec<usize>,
+    // Writer and its row
+    writers: Vec<(Arc<Channel>, usize)>,
+}
+
+thread_local! {
+    static MULTI_PUSH_SCRATCH: std::cell::RefCell<MultiPushScratch> = Default::default();
+}
+
+fn push_rows(scratch: &mut MultiPushScratch, handles: &[u64], timestamps: &[u64], values: &[f64]) -> c_int {
+    let n_samples = timestamps.len();
+
+    // Sorting by handle puts repeated handles next to each other
+    let rows = &mut scratch.rows;
+    rows.clear();
+    rows.extend(0..handles.len());
+    rows.sort_unstable_by_key(|&row| handles[row]);
+    if let Some(pair) = rows.windows(2).find(|pair| handles[pair[0]] == handles[pair[1]]) {
+        set_last_error_fmt(format_args!(
+            "Writer handle {} appears in rows {} and {}",
+            handles[pair[0]],
+            pair[0].min(pair[1]),
+            pair[0].max(pair[1])
+        ));
+        return ERROR_INVALID_PARAM;
+    }
+
+    for &row in rows.iter() {
+        match lookup_writer(handles[row]) {
+            Ok(w) => scratch.writers.push((w, row)),
+            Err(e) => return e,
+        }
+    }
+
+    // A channel whose async queue is full is skipped; the others still get
+    // their rows and the error is reported after the fan-out
+    let mut status = SUCCESS;
+    for &(ref writer_arc, row) in &scratch.writers {
+        let row_values = &values[row * n_samples..(row + 1) * n_samples];
+        let result = writer_arc.push_batch(n_samples, |sink| {
+            for (&timestamp, &value) in timestamps.iter().zip(row_values) {
+                sink.push(timestamp, value);
+            }
+        });
+        if let Err(e) = result {
+            status = e;
+        }
+    }
+
+    status
+}
+
+/// Push a batch of interleaved (timestamp, value) points
+///
+/// Reads the cluster array in a single pass and appends each point directly,
+/// so LabVIEW doesn't need to split it into separate timestamp and value arrays.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `points` - Array of `{u64 timestamp_ns; f64 value}` clusters
+/// * `count` - Number of points in the array
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_points_xy(
+    writer_handle: u64,
+    points: *const PointXY,
+    count: usize,
+) -> c_int {
+    clear_last_error();
+
+    // Validate pointers
+    if points.is_null() {
+        set_last_error("Null pointer provided for data array".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    if count == 0 {
+        return SUCCESS; // Nothing to do
+    }
+
+    // Get writer state
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    let points_slice = std::slice::from_raw_parts(points, count);
+
+    let result = writer_arc.push_batch(count, |sink| {
+        for point in points_slice {
+            sink.push(point.timestamp_ns, point.value);
+        }
+    });
+
+    match result {
+        Ok(()) => SUCCESS,
+        Err(e) => e,
+    }
+}
+
+/// Push a batch of interleaved (value, timestamp) points
+///
+/// Reads the cluster array in a single pass and appends each point directly,
+/// so LabVIEW doesn't need to split it into separate timestamp and value arrays.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `points` - Array of `{f64 value; u64 timestamp_ns}` clusters
+/// * `count` - Number of points in the array
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_push_points_yx(
+    writer_handle: u64,
+    points: *const PointYX,
+    count: usize,
+) -> c_int {
+    clear_last_error();
+
+    // Validate pointers
+    if points.is_null() {
+        set_last_error("Null pointer provided for data array".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    if count == 0 {
+        return SUCCESS; // Nothing to do
+    }
+
+    // Get writer state
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    let points_slice = std::slice::from_raw_parts(points, count);
+
+    let result = writer_arc.push_batch(count, |sink| {
+        for point in points_slice {
+            sink.push(point.timestamp_ns, point.value);
+        }
+    });
+
+    match result {
+        Ok(()) => SUCCESS,
+        Err(e) => e,
+    }
+}
+
+/// Switch a channel to asynchronous, non-blocking pushes
+///
+/// After this call every push on the handle only copies its points into a
+/// preallocated single-producer/single-consumer ring of `capacity` points
+/// (rounded up to a power of two), and the library drains the ring into the
+/// stream on its runtime's blocking pool. The caller's thread never touches
+/// the writer, the stream or the network, and a drain stuck on a full stream
+/// or a slow spool disk holds neither the caller nor the runtime's workers.
+///
+/// When the batch fits in the ring, push latency is bounded by: one handle
+/// lookup (wait-free), one per-handle producer lock (contended only by other
+/// threads pushing to the same handle), a copy of 16 bytes per point into the
+/// ring, one release store, and one runtime wake-up (an atomic op that may
+/// unpark an idle worker thread). The drain doesn't share a lock with that
+/// path, so how long it takes shows up only as ring occupancy and
+/// `queue_latency` in `nominal_get_channel_stats`.
+///
+/// After the first push on a thread, pushes don't allocate, including ones
+/// rejected with `ERROR_QUEUE_FULL`. Synchronous channels append into
+/// nominal-streaming's writer on the caller's thread, and that writer
+/// allocates whenever it hands a buffer to the stream.
+///
+/// A batch that doesn't fit in the free space is rejected as a whole with
+/// `ERROR_QUEUE_FULL` (-6), unless the stream has a backpressure policy; see
+/// `nominal_init_ex` for how long each policy can wait. Size the ring for the
+/// longest upload stall you want to ride through. Async mode cannot be turned
+/// off again for a handle.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `capacity` - Ring size in points (1 to 2^26)
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_enable_async(writer_handle: u64, capacity: usize) -> c_int {
+    clear_last_error();
+
+    // Get writer state
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    match writer_arc.enable_async(capacity) {
+        Ok(()) => SUCCESS,
+        Err(e) => e,
+    }
+}
+
+/// Flush a channel's buffered points to its stream, waiting up to a timeout
+///
+/// Moves everything queued for the channel (including an async ring) into the
+/// stream, which sends it with its next request. Use this to time uploads,
+/// for example between test steps, rather than waiting for the buffer to
+/// fill. Pushes to the channel wait while the flush runs; other channels are
+/// unaffected.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `timeout_ms` - Maximum time to wait, in milliseconds
+///
+/// # Returns
+/// 0 on success, ERROR_RUNTIME if the timeout passed (the flush still
+/// completes in the background), other negative codes on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_flush_channel(writer_handle: u64, timeout_ms: u32) -> c_int {
+    clear_last_error();
+
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    flush_channels(vec![writer_arc], Some(Duration::from_millis(timeout_ms as u64)))
+}
+
+/// Start flushing a channel's buffered points to its stream and return at once
+///
+/// Same as `nominal_flush_channel`, but the flush runs on the library's
+/// runtime and the caller does not wait for it.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_flush_channel_async(writer_handle: u64) -> c_int {
+    clear_last_error();
+
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    flush_channels(vec![writer_arc], None)
+}
+
+/// Flush every open channel on a stream, waiting up to a timeout
+///
+/// Channels are flushed in parallel. The stream then sends the points with
+/// its next requests, within its request delay.
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `timeout_ms` - Maximum time to wait, in milliseconds
+///
+/// # Returns
+/// 0 on success, ERROR_RUNTIME if the timeout passed (the flush still
+/// completes in the background), other negative codes on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_flush_stream(stream_handle: u64, timeout_ms: u32) -> c_int {
+    clear_last_error();
+
+    let stream = match STREAMS.get(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return ERROR_INVALID_HANDLE;
+        }
+    };
+
+    let channels = stream_channels(&stream).into_iter().map(|(_, c)| c).collect();
+    flush_channels(channels, Some(Duration::from_millis(timeout_ms as u64)))
+}
+
+/// Start flushing every open channel on a stream and return at once
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_flush_stream_async(stream_handle: u64) -> c_int {
+    clear_last_error();
+
+    let stream = match STREAMS.get(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return ERROR_INVALID_HANDLE;
+        }
+    };
+
+    let channels = stream_channels(&stream).into_iter().map(|(_, c)| c).collect();
+    flush_channels(channels, None)
+}
+
+/// Close a channel writer and flush remaining data
+/// 
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// 
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_close_channel(writer_handle: u64) -> c_int {
+    clear_last_error();
+
+    // Remove writer from registry
+    let writer_arc = match WRITERS.remove(writer_handle) {
+        Some(w) => w,
+        None => {
+            set_last_error(format!("Invalid writer handle: {}", writer_handle));
+            return ERROR_INVALID_HANDLE;
+        }
+    };
+
+    unindex_channel(&mut writer_arc.stream.channel_index.write(), &writer_arc, writer_handle);
+
+    // Let an async drain task empty its ring, then drop the writer - this
+    // flushes its buffered points into the stream
+    writer_arc.close();
+    drop(writer_arc);
+
+    SUCCESS
+}
+
+/// Get the counts of points the stream's backpressure policy discarded or spilled
+///
+/// ```c
+/// typedef struct {
+///     uint64_t dropped_points;  // discarded by drop oldest/newest
+///     uint64_t spilled_points;  // written to the spill file
+///     uint64_t block_timeouts;  // pushes rejected after blocking for the timeout
+/// } NominalBackpressureCounters;
+/// ```
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init_ex
+/// * `out_counters` - Output pointer for the counters
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_get_backpressure_counters(
+    stream_handle: u64,
+    out_counters: *mut NominalBackpressureCounters,
+) -> c_int {
+    clear_last_error();
+
+    if out_counters.is_null() {
+        set_last_error("Output counters pointer is null".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let stream = match STREAMS.get(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return ERROR_INVALID_HANDLE;
+        }
+    };
+
+    *out_counters = stream.counters.snapshot();
+    SUCCESS
+}
+
+/// Get a channel's point counts and latency histograms
+///
+/// ```c
+/// typedef struct {
+///     uint64_t count;
+///     uint64_t mean_ns;
+///     uint64_t p50_ns;
+///     uint64_t p90_ns;
+///     uint64_t p99_ns;
+///     uint64_t max_ns;
+/// } NominalLatencyStats;
+///
+/// typedef struct {
+///     uint64_t struct_size;              // sizeof(NominalChannelStats)
+///     uint64_t points_accepted;          // net of dropped and spilled points
+///     uint64_t bytes_accepted;           // 16 bytes per point
+///     uint64_t queued_points;            // waiting in the async ring
+///     NominalLatencyStats push_latency;  // duration of push calls
+///     NominalLatencyStats queue_latency; // oldest point's wait in the async ring
+///     NominalLatencyStats flush_latency; // handing the buffer to the stream
+///     uint64_t points_suppressed;        // dropped by compression
+/// } NominalChannelStats;
+/// ```
+///
+/// Percentiles are accurate to within 12.5%. Only `struct_size` bytes are
+/// written, so callers built against an older, shorter struct keep working.
+///
+/// # Arguments
+/// * `writer_handle` - Writer handle from nominal_create_channel
+/// * `out_stats` - Stats struct with `struct_size` set
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_get_channel_stats(
+    writer_handle: u64,
+    out_stats: *mut NominalChannelStats,
+) -> c_int {
+    clear_last_error();
+
+    if out_stats.is_null() {
+        set_last_error("Output stats pointer is null".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let writer_arc = match lookup_writer(writer_handle) {
+        Ok(w) => w,
+        Err(e) => return e,
+    };
+
+    let channel_stats = &writer_arc.stats;
+    let points_accepted = channel_stats.points_accepted.load(Ordering::Relaxed);
+    let snapshot = NominalChannelStats {
+        struct_size: std::mem::size_of::<NominalChannelStats>() as u64,
+        points_accepted,
+        bytes_accepted: stats::point_bytes(points_accepted),
+        queued_points: writer_arc.queued_points() as u64,
+        push_latency: channel_stats.push_latency.summary(),
+        queue_latency: channel_stats.queue_latency.summary(),
+        flush_latency: channel_stats.flush_latency.summary(),
+        points_suppressed: channel_stats.points_suppressed.load(Ordering::Relaxed),
+    };
+
+    match stats::write_versioned(out_stats, &snapshot) {
+        Ok(()) => SUCCESS,
+        Err(e) => {
+            set_last_error(e);
+            ERROR_INVALID_PARAM
+        }
+    }
+}
+
+/// Get a stream's totals over every channel it has had
+///
+/// ```c
+/// typedef struct {
+///     uint64_t struct_size;              // sizeof(NominalStreamStats)
+///     uint64_t channels_open;
+///     uint64_t points_accepted;
+///     uint64_t bytes_accepted;
+///     uint64_t queued_points;
+///     uint64_t dropped_points;           // see nominal_get_backpressure_counters
+///     uint64_t spilled_points;
+///     uint64_t block_timeouts;
+///     NominalLatencyStats push_latency;
+///     NominalLatencyStats queue_latency;
+///     NominalLatencyStats flush_latency;
+///     uint64_t spool_segments_acked;     // see nominal_init_spool
+///     uint64_t spool_segments_pending;   // left by earlier runs, not yet replayed
+///     uint64_t spool_replayed_points;
+///     uint64_t spool_errors;             // failed segment writes or unreadable segments
+///     uint64_t spool_segments;           // on disk now
+///     uint64_t spool_bytes;
+///     uint64_t spool_segments_evicted;   // deleted unsent, see spool_max_segments
+///     uint64_t points_suppressed;
+///     uint64_t spool_points_evicted;     // points in the evicted segments
+///     uint64_t spool_evicted_first_ns;   // earliest timestamp evicted (0 if none)
+///     uint64_t spool_evicted_last_ns;    // latest timestamp evicted (0 if none)
+/// } NominalStreamStats;
+/// ```
+///
+/// Fields mean the same as in `nominal_get_channel_stats`; the histograms
+/// merge every channel's samples.
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `out_stats` - Stats struct with `struct_size` set
+///
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_get_stream_stats(
+    stream_handle: u64,
+    out_stats: *mut NominalStreamStats,
+) -> c_int {
+    clear_last_error();
+
+    if out_stats.is_null() {
+        set_last_error("Output stats pointer is null".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let stream = match STREAMS.get(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return ERROR_INVALID_HANDLE;
+        }
+    };
+
+    let channels = stream_channels(&stream);
+    let total = ChannelStats::default();
+    total.absorb(&stream.retired_stats);
+    let mut queued_points = 0;
+    for (_, channel) in &channels {
+        total.absorb(&channel.stats);
+        queued_points += channel.queued_points() as u64;
+    }
+
+    let counters = stream.counters.snapshot();
+    let points_accepted = total.points_accepted.load(Ordering::Relaxed);
+    let spool_counter = |f: fn(&spool::SpoolCounters) -> &AtomicU64| {
+        stream.spool.as_ref().map_or(0, |s| f(&s.counters).load(Ordering::Relaxed))
+    };
+    let (spool_segments, spool_bytes) = stream.spool.as_ref().map_or((0, 0), |s| s.usage());
+    let (spool_evicted_first_ns, spool_evicted_last_ns) =
+        stream.spool.as_ref().map_or((0, 0), |s| s.counters.evicted_span());
+    let snapshot = NominalStreamStats {
+        struct_size: std::mem::size_of::<NominalStreamStats>() as u64,
+        channels_open: channels.len() as u64,
+        points_accepted,
+        bytes_accepted: stats::point_bytes(points_accepted),
+        queued_points,
+        dropped_points: counters.dropped_points,
+        spilled_points: counters.spilled_points,
+        block_timeouts: counters.block_timeouts,
+        push_latency: total.push_latency.summary(),
+        queue_latency: total.queue_latency.summary(),
+        flush_latency: total.flush_latency.summary(),
+        spool_segments_acked: spool_counter(|c| &c.segments_acked),
+        spool_segments_pending: spool_counter(|c| &c.segments_pending_replay),
+        spool_replayed_points: spool_counter(|c| &c.replayed_points),
+        spool_errors: spool_counter(|c| &c.write_errors),
+        spool_segments,
+        spool_bytes,
+        spool_segments_evicted: spool_counter(|c| &c.segments_evicted),
+        points_suppressed: total.points_suppressed.load(Ordering::Relaxed),
+        spool_points_evicted: spool_counter(|c| &c.points_evicted),
+        spool_evicted_first_ns,
+        spool_evicted_last_ns,
+    };
+
+    match stats::write_versioned(out_stats, &snapshot) {
+        Ok(()) => SUCCESS,
+        Err(e) => {
+            set_last_error(e);
+            ERROR_INVALID_PARAM
+        }
+    }
+}
+
+/// Shutdown stream and cleanup resources
+/// 
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// 
+/// # Returns
+/// 0 on success, negative error code on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_shutdown(stream_handle: u64) -> c_int {
+    clear_last_error();
+
+    // Remove stream from registry
+    let _stream = match STREAMS.remove(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return ERROR_INVALID_HANDLE;
+        }
+    };
+
+    // Stream will be dropped here, triggering cleanup
+    SUCCESS
+}
+
+/// Shut down a stream within a deadline and report what happened to its data
+///
+/// Closes every channel still open on the stream (their handles become
+/// invalid), flushes them in parallel on the runtime, then closes the stream
+/// so it sends, or writes to its fallback file, whatever it still buffers.
+/// Returns once that is done or `deadline_ms` has passed, whichever is first.
+///
+/// ```c
+/// typedef struct {
+///     uint64_t points_sent;         // sent or written to fallback by a stream closed in time
+///     uint64_t points_spilled;      // written to the spill file by backpressure
+///     uint64_t points_lost;         // dropped by backpressure or still held at the deadline
+///     uint64_t channels_closed;
+///     uint64_t channels_timed_out;
+///     uint64_t stream_closed;       // 1 if the stream itself finished flushing in time
+/// } NominalShutdownReport;
+/// ```
+///
+/// Points only count as sent if `stream_closed` is 1. If it is 0, every point
+/// accepted by the channels counts as lost: the stream had not finished
+/// uploading them (or writing them to the fallback file) at the deadline.
+/// Work that misses the deadline keeps running in the background until the
+/// process exits, so some of those points may still arrive.
+///
+/// # Arguments
+/// * `stream_handle` - Stream handle from nominal_init
+/// * `deadline_ms` - Maximum time to wait, in milliseconds
+/// * `out_report` - Output pointer for the report (can be null)
+///
+/// # Returns
+/// 0 if everything closed before the deadline, ERROR_RUNTIME if the deadline
+/// passed (the report is still filled in), other negative codes on failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_shutdown_ex(
+    stream_handle: u64,
+    deadline_ms: u32,
+    out_report: *mut NominalShutdownReport,
+) -> c_int {
+    clear_last_error();
+
+    let stream = match STREAMS.remove(stream_handle) {
+        Some(s) => s,
+        None => {
+            set_last_error(format!("Invalid stream handle: {}", stream_handle));
+            return ERROR_INVALID_HANDLE;
+        }
+    };
+
+    // Detach every channel on this stream so no new pushes reach it
+    let channels: Vec<Arc<Channel>> = {
+        let mut index = stream.channel_index.write();
+        stream_channels(&stream)
+            .into_iter()
+            .filter_map(|(handle, _)| {
+                let channel = WRITERS.remove(handle)?;
+                unindex_channel(&mut index, &channel, handle);
+                Some(channel)
+            })
+            .collect()
+    };
+
+    let deadline = Duration::from_millis(deadline_ms as u64);
+    let report = RUNTIME.block_on(shutdown::shutdown(stream, channels, deadline));
+
+    if !out_report.is_null() {
+        *out_report = report;
+    }
+
+    if report.channels_timed_out > 0 || report.stream_closed == 0 {
+        set_last_error(format!(
+            "Shutdown deadline of {} ms passed: {} channels unfinished, stream {}",
+            deadline_ms,
+            report.channels_timed_out,
+            if report.stream_closed != 0 { "closed" } else { "still flushing" }
+        ));
+        return ERROR_RUNTIME;
+    }
+    SUCCESS
+}
+
+/// Upload fallback AVRO files written by earlier streams to a dataset
+///
+/// Streams every file matching `glob` to Core, `parallelism` files at a time,
+/// through the same writers live data uses. Each record's channel, tags and
+/// double values are sent; records holding other value types are counted as
+/// unsupported and skipped.
+///
+/// Progress is checkpointed in a `<file>.progress` file next to each file.
+/// After every million points the upload stream is closed, so its points are
+/// either sent or written to a `<file>.retry-<record>.avro` fallback, and
+/// only then does the checkpoint advance. Calling again with the same glob
+/// resumes interrupted files and skips finished ones. A glob like `*.avro`
+/// also matches the `.retry-<record>.avro` files and any `.spill.avro`
+/// files, so the next call uploads those too.
+///
+/// Points from a chunk that wrote anything to its retry file count as
+/// retried, not uploaded, and so does the file: nominal-streaming doesn't
+/// report which of them were sent. The file's checkpoint still completes,
+/// since the retry file holds what didn't go, but the call returns
+/// `ERROR_IO`.
+///
+/// ```c
+/// typedef struct {
+///     uint64_t files_matched;
+///     uint64_t files_uploaded;
+///     uint64_t files_skipped;        // finished by an earlier call
+///     uint64_t files_failed;
+///     uint64_t records_uploaded;
+///     uint64_t points_uploaded;
+///     uint64_t records_unsupported;
+///     uint64_t files_retried;        // wrote to a retry file instead
+///     uint64_t records_retried;
+///     uint64_t points_retried;
+/// } NominalUploadReport;
+/// ```
+///
+/// Blocks until every file is done.
+///
+/// # Arguments
+/// * `token` - Nominal API token (can be null to use env var NOMINAL_TOKEN)
+/// * `dataset_rid` - Dataset RID (e.g., "ri.catalog.main.dataset....")
+/// * `glob` - File pattern; `*` and `?` are allowed in the file name only
+/// * `parallelism` - Files uploaded concurrently (0 = 1)
+/// * `out_report` - Output pointer for the report (can be null)
+///
+/// # Returns
+/// 0 on success, ERROR_IO if any file failed or was retried (the report is
+/// still filled in and the last error says why), other negative codes on
+/// failure
+#[no_mangle]
+pub unsafe extern "C" fn nominal_upload_fallback_files(
+    token: *const c_char,
+    dataset_rid: *const c_char,
+    glob: *const c_char,
+    parallelism: u32,
+    out_report: *mut NominalUploadReport,
+) -> c_int {
+    clear_last_error();
+
+    let token_str = if !token.is_null() {
+        match c_str_to_string(token) {
+            Ok(s) => Some(s),
+            Err(e) => {
+                set_last_error(format!("Invalid token: {}", e));
+                return ERROR_INVALID_PARAM;
+            }
+        }
+    } else {
+        None
+    };
+    if token_str.is_none() && std::env::var("NOMINAL_TOKEN").is_err() {
+        set_last_error("Uploading requires a token or NOMINAL_TOKEN".to_string());
+        return ERROR_INVALID_PARAM;
+    }
+
+    let dataset_rid_str = match c_str_to_string(dataset_rid) {
+        Ok(s) => s,
+        Err(e) => {
+            set_last_error(format!("Invalid dataset RID: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    let pattern = match c_str_to_string(glob) {
+        Ok(s) => s,
+        Err(e) => {
+            set_last_error(format!("Invalid glob: {}", e));
+            return ERROR_INVALID_PARAM;
+        }
+    };
+
+    let files = match upload::glob(&pattern) {
+        Ok(f) => f,
+        Err(e) => {
+            set_last_error(format!("Failed to list {}: {}", pattern, e));
+            return ERROR_IO;
+        }
+    };
+
+    // Start the runtime, surfacing any affinity/priority failure
+    Lazy::force(&RUNTIME);
+    if let Some(e) = runtime::thread_setup_error() {
+        set_last_error(format!("Runtime thread setup failed: {}", e));
+        return ERROR_RUNTIME;
+    }
+
+    // Check the token and RID here, where the error can be reported
+    if let Err(e) = stream_builder(token_str.clone(), &dataset_rid_str, None) {
+        return e;
+    }
+    let new_stream: Arc<upload::StreamFactory> = Arc::new(move |fallback: &std::path::Path| {
+        let builder = stream_builder(token_str.clone(), &dataset_rid_str, fallback.to_str()).ok()?;
+        Some(builder.build())
+    });
+
+    let parallelism = (parallelism as usize).max(1);
+    let (report, error) = RUNTIME.block_on(upload::upload(files, parallelism, new_stream));
+
+    if !out_report.is_null() {
+        *out_report = report;
+    }
+
+    if let Some(e) = error {
+        set_last_error(format!("{} of {} files failed, first: {}", report.files_failed, report.files_matched, e));
+        return ERROR_IO;
+    }
+    if report.files_retried > 0 {
+        set_last_error(format!(
+            "{} of {} files wrote {} points to retry files; upload those to finish",
+            report.files_retried, report.files_matched, report.points_retried
+        ));
+        return ERROR_IO;
+    }
+    SUCCESS
+}
+
+/// Get the last error message
+/// 
+/// # Arguments
+/// * `buffer` - Output buffer for error message
+/// * `buffer_size` - Size of the buffer
+/// 
+/// # Returns
+/// 0 on success, negative error code if no error or buffer too small
+
+#[no_mangle]
+pub extern "C" fn nominal_get_last_error(
+    buffer: *mut c_char,
+    buffer_size: usize,
+) -> i32 {
+    if buffer.is_null() || buffer_size == 0 {
+        return -3;
+    }
+
+    LAST_ERROR.with(|last_error| {
+        let last_error = last_error.borrow();
+        if !last_error.set {
+            // No error stored, write empty string
+            unsafe {
+                *buffer = 0;
+            }
+            return -1;
+        }
+        let msg = &last_error.message;
 
         let error_bytes = msg.as_bytes();
         let copy_len = std::cmp::min(error_bytes.len(), buffer_size - 1);
@@ -522,9 +2948,860 @@ mod tests {
 
     #[test]
     fn test_handle_allocation() {
-        let h1 = allocate_stream_handle();
-        let h2 = allocate_stream_handle();
+        let table = HandleTable::new();
+        let h1 = table.insert(Arc::new(1u32)).unwrap();
+        let h2 = table.insert(Arc::new(2u32)).unwrap();
         assert_ne!(h1, h2);
-        assert!(h2 > h1);
+        assert_ne!(h1, 0);
+        assert_ne!(h2, 0);
+    }
+
+    #[test]
+    fn test_point_layouts() {
+        assert_eq!(std::mem::size_of::<PointXY>(), 16);
+        assert_eq!(std::mem::size_of::<PointYX>(), 16);
+        assert_eq!(std::mem::align_of::<PointXY>(), 1);
+    }
+
+    #[test]
+    fn test_waveform_timestamp() {
+        assert_eq!(waveform_timestamp(1_000, 10_000.0, 0), 1_000);
+        assert_eq!(waveform_timestamp(1_000, 10_000.0, 3), 31_000);
+        // 3 kHz: a fractional period must not drift over many samples
+        assert_eq!(waveform_timestamp(0, 1e9 / 3000.0, 3_000_000), 1_000_000_000_000);
+    }
+
+    /// A stream with one untagged channel, falling back to a temp file named
+    /// after the test. Dropping it shuts the stream down with its channels.
+    struct TestStream {
+        stream: u64,
+        writer: u64,
+    }
+
+    impl TestStream {
+        fn new(test: &str, channel: &str) -> Self {
+            Self::with_options(test, channel, std::ptr::null())
+        }
+
+        fn with_options(test: &str, channel: &str, options: *const NominalStreamOptions) -> Self {
+            let path = std::env::temp_dir().join(format!("nominal_ffi_test_{}.avro", test));
+            let path = CString::new(path.to_str().unwrap()).unwrap();
+            let rid = CString::new("ri.catalog.main.dataset.test").unwrap();
+            let mut stream = 0u64;
+            assert_eq!(
+                unsafe { nominal_init_ex(std::ptr::null(), rid.as_ptr(), path.as_ptr(), options, &mut stream) },
+                SUCCESS
+            );
+            let mut fixture = Self { stream, writer: 0 };
+            fixture.writer = fixture.channel(channel);
+            fixture
+        }
+
+        /// Open another untagged channel on the stream
+        fn channel(&self, name: &str) -> u64 {
+            let name = CString::new(name).unwrap();
+            let mut writer = 0u64;
+            assert_eq!(
+                unsafe { nominal_create_channel(self.stream, name.as_ptr(), std::ptr::null(), &mut writer) },
+                SUCCESS
+            );
+            writer
+        }
+    }
+
+    impl Drop for TestStream {
+        fn drop(&mut self) {
+            // A no-op for tests that already shut the stream down
+            unsafe { nominal_shutdown_ex(self.stream, 2_000, std::ptr::null_mut()) };
+        }
+    }
+
+    #[test]
+    fn test_async_push() {
+        let fixture = TestStream::new("async_push", "pressure");
+        let writer = fixture.writer;
+
+        unsafe {
+            assert_eq!(nominal_enable_async(writer, 0), ERROR_INVALID_PARAM);
+            assert_eq!(nominal_enable_async(writer, 4), SUCCESS);
+            assert_eq!(nominal_enable_async(writer, 4), ERROR_INVALID_PARAM);
+
+            let timestamps = [1_000u64, 2_000, 3_000];
+            let values = [1.0f64, 2.0, 3.0];
+            assert_eq!(
+                nominal_push_double_batch(writer, timestamps.as_ptr(), values.as_ptr(), 3),
+                SUCCESS
+            );
+
+            let big: Vec<f64> = vec![0.0; 5];
+            assert_eq!(nominal_push_waveform(writer, 0, 1.0, big.as_ptr(), big.len()), ERROR_QUEUE_FULL);
+        }
+    }
+
+    // Counts heap allocations made on threads that opt in, so work on the
+    // runtime's threads and other tests doesn't show up
+    struct CountingAllocator;
+
+    thread_local! {
+        static COUNT_ALLOCATIONS: std::cell::Cell<bool> = const { std::cell::Cell::new(false) };
+        static ALLOCATIONS: std::cell::Cell<u64> = const { std::cell::Cell::new(0) };
+    }
+
+    fn count_allocation() {
+        if COUNT_ALLOCATIONS.try_with(|c| c.get()).unwrap_or(false) {
+            let _ = ALLOCATIONS.try_with(|a| a.set(a.get() + 1));
+        }
+    }
+
+    unsafe impl std::alloc::GlobalAlloc for CountingAllocator {
+        unsafe fn alloc(&self, layout: std::alloc::Layout) -> *mut u8 {
+            count_allocation();
+            std::alloc::System.alloc(layout)
+        }
+
+        unsafe fn alloc_zeroed(&self, layout: std::alloc::Layout) -> *mut u8 {
+            count_allocation();
+            std::alloc::System.alloc_zeroed(layout)
+        }
+
+        unsafe fn realloc(&self, ptr: *mut u8, layout: std::alloc::Layout, new_size: usize) -> *mut u8 {
+            count_allocation();
+            std::alloc::System.realloc(ptr, layout, new_size)
+        }
+
+        unsafe fn dealloc(&self, ptr: *mut u8, layout: std::alloc::Layout) {
+            std::alloc::System.dealloc(ptr, layout)
+        }
+    }
+
+    #[global_allocator]
+    static ALLOCATOR: CountingAllocator = CountingAllocator;
+
+    /// Heap allocations `f` makes on the calling thread
+    fn allocations_in(f: impl FnOnce()) -> u64 {
+        ALLOCATIONS.with(|a| a.set(0));
+        COUNT_ALLOCATIONS.with(|c| c.set(true));
+        f();
+        COUNT_ALLOCATIONS.with(|c| c.set(false));
+        ALLOCATIONS.with(|a| a.get())
+    }
+
+    #[test]
+    fn test_async_push_does_not_allocate() {
+        let fixture = TestStream::new("push_alloc", "a");
+        let writers = [fixture.writer, fixture.channel("b"), fixture.channel("full")];
+
+        unsafe {
+            assert_eq!(nominal_enable_async(writers[0], 1 << 16), SUCCESS);
+            assert_eq!(nominal_enable_async(writers[1], 1 << 16), SUCCESS);
+            assert_eq!(nominal_enable_async(writers[2], 4), SUCCESS);
+
+            let gain = [0.5f64, 2.0];
+            assert_eq!(nominal_set_channel_scale(writers[1], gain.as_ptr(), 2), SUCCESS);
+
+            let timestamps: Vec<u64> = (0..100).collect();
+            let values = vec![1.0f64; 200];
+            let raw_i16 = vec![7i16; 100];
+            let raw_f32 = vec![7.0f32; 100];
+            let push = || {
+                assert_eq!(
+                    nominal_push_double_batch(writers[0], timestamps.as_ptr(), values.as_ptr(), 100),
+                    SUCCESS
+                );
+                assert_eq!(nominal_push_i16_batch(writers[1], timestamps.as_ptr(), raw_i16.as_ptr(), 100), SUCCESS);
+                assert_eq!(nominal_push_f32_batch(writers[1], timestamps.as_ptr(), raw_f32.as_ptr(), 100), SUCCESS);
+                assert_eq!(
+                    nominal_push_multi_double_batch(writers.as_ptr(), 2, timestamps.as_ptr(), values.as_ptr(), 100),
+                    SUCCESS
+                );
+                // The error path formats into the last error's existing buffer
+                assert_eq!(
+                    nominal_push_double_batch(writers[2], timestamps.as_ptr(), values.as_ptr(), 100),
+                    ERROR_QUEUE_FULL
+                );
+            };
+
+            // Synchronous channels are exempt: nominal-streaming's writer
+            // allocates its own buffers. Warm up: first pushes grow the last
+            // error and scratch buffers.
+            push();
+            assert_eq!(allocations_in(|| (0..100).for_each(|_| push())), 0);
+        }
+    }
+
+    /// A LabVIEW array of strings, laid out as LabVIEW passes it
+    struct LvStrings {
+        _blocks: Vec<Vec<u8>>,
+        _pointers: Vec<*const labview::LStr>,
+        _array: Vec<u64>,
+        array_ptr: Box<*const labview::LvArray1D<LStrHandle>>,
+    }
+
+    impl LvStrings {
+        fn new(strings: &[&str]) -> Self {
+            let blocks: Vec<Vec<u8>> = strings
+                .iter()
+                .map(|s| [&(s.len() as i32).to_ne_bytes()[..], s.as_bytes()].concat())
+                .collect();
+            let pointers: Vec<*const labview::LStr> = blocks.iter().map(|b| b.as_ptr() as *const _).collect();
+            // dimSize, padded to the handles' alignment, then the handles
+            let mut array = vec![0u64; 1 + strings.len()];
+            unsafe { std::ptr::write_unaligned(array.as_mut_ptr() as *mut i32, strings.len() as i32) };
+            for (i, slot) in array[1..].iter_mut().enumerate() {
+                *slot = unsafe { pointers.as_ptr().add(i) } as u64;
+            }
+            let array_ptr = Box::new(array.as_ptr() as *const labview::LvArray1D<LStrHandle>);
+            Self {
+                _blocks: blocks,
+                _pointers: pointers,
+                _array: array,
+                array_ptr,
+            }
+        }
+
+        fn handle(&self) -> LvArrayHandle<LStrHandle> {
+            &*self.array_ptr
+        }
+    }
+
+    #[test]
+    fn test_async_typed_push_skips_writer() {
+        let fixture = TestStream::new("typed_push_latency", "strain");
+        let writer = fixture.writer;
+
+        unsafe {
+            assert_eq!(nominal_enable_async(writer, 1024), SUCCESS);
+            let gain = [0.0f64, 2.0];
+            assert_eq!(nominal_set_channel_scale(writer, gain.as_ptr(), 2), SUCCESS);
+
+            // Hold the writer as a drain stuck on a full stream would; typed
+            // pushes must still go straight into the ring
+            let channel = WRITERS.get(writer).unwrap();
+            let stalled = channel.state.lock();
+            let (done, result) = std::sync::mpsc::channel();
+            let pusher = std::thread::spawn(move || {
+                let timestamps = [1u64, 2, 3];
+                let raw = [1i32, 2, 3];
+                let _ = done.send(nominal_push_i32_batch(writer, timestamps.as_ptr(), raw.as_ptr(), 3));
+            });
+            let pushed = result.recv_timeout(Duration::from_secs(5));
+            drop(stalled);
+            pusher.join().unwrap();
+            assert_eq!(pushed, Ok(SUCCESS));
+        }
+    }
+
+    /// Name and tags of an open channel, from its index key
+    fn channel_identity(writer: u64) -> (String, Vec<(String, String)>) {
+        let channel = WRITERS.get(writer).unwrap();
+        let (name, tags) = &channel.key;
+        let table = &channel.stream.tags;
+        let tags = table
+            .resolve(tags)
+            .iter()
+            .map(|(k, v)| (k.to_string(), v.to_string()))
+            .collect();
+        (table.string(*name).to_string(), tags)
+    }
+
+    #[test]
+    fn test_create_channels() {
+        let fixture = TestStream::new("create_channels", "existing");
+        let stream = fixture.stream;
+        let names: Vec<CString> = (0..3).map(|i| CString::new(format!("tc{}", i)).unwrap()).collect();
+        let tags = CString::new("rig=7,test=burn_in").unwrap();
+        let mut name_ptrs: Vec<*const c_char> = names.iter().map(|n| n.as_ptr()).collect();
+        let tag_ptrs = [tags.as_ptr(), tags.as_ptr(), std::ptr::null()];
+        let mut stats = NominalStreamStats {
+            struct_size: std::mem::size_of::<NominalStreamStats>() as u64,
+            ..Default::default()
+        };
+
+        unsafe {
+            let mut handles = [0u64; 3];
+            assert_eq!(
+                nominal_create_channels(stream, name_ptrs.as_ptr(), tag_ptrs.as_ptr(), 3, handles.as_mut_ptr()),
+                SUCCESS
+            );
+            for (i, &handle) in handles.iter().enumerate() {
+                let (name, tags) = channel_identity(handle);
+                assert_eq!(name, format!("tc{}", i));
+                assert_eq!(tags.len(), if i < 2 { 2 } else { 0 });
+            }
+
+            // A bad name fails the whole call and creates nothing
+            name_ptrs[1] = std::ptr::null();
+            let mut more = [0u64; 3];
+            assert_eq!(
+                nominal_create_channels(stream, name_ptrs.as_ptr(), std::ptr::null(), 3, more.as_mut_ptr()),
+                ERROR_INVALID_PARAM
+            );
+            assert_eq!(more, [0; 3]);
+            assert_eq!(nominal_get_stream_stats(stream, &mut stats), SUCCESS);
+            assert_eq!(stats.channels_open, 1 + 3);
+
+            // The LabVIEW variant rejects the same empty name, and an output
+            // array too small for the names
+            let no_tags = LvStrings::new(&[]);
+            let empty_name = LvStrings::new(&["lv0", ""]);
+            assert_eq!(
+                nominal_create_channels_lv(stream, empty_name.handle(), no_tags.handle(), more.as_mut_ptr(), 3),
+                ERROR_INVALID_PARAM
+            );
+            let lv_names = LvStrings::new(&["lv0", "lv1"]);
+            assert_eq!(
+                nominal_create_channels_lv(stream, lv_names.handle(), no_tags.handle(), more.as_mut_ptr(), 1),
+                ERROR_INVALID_PARAM
+            );
+            assert_eq!(more, [0; 3]);
+            assert_eq!(
+                nominal_create_channels_lv(stream, lv_names.handle(), no_tags.handle(), more.as_mut_ptr(), 2),
+                SUCCESS
+            );
+            assert_eq!(channel_identity(more[1]).0, "lv1");
+        }
+    }
+
+    #[test]
+    fn test_create_channel_with_tags() {
+        let fixture = TestStream::new("tag_arrays", "pressure");
+        let stream = fixture.stream;
+        let name = CString::new("pressure").unwrap();
+        let strings: Vec<CString> = ["rig", "7", "note", "a=b,c"].iter().map(|s| CString::new(*s).unwrap()).collect();
+        let keys = [strings[0].as_ptr(), strings[2].as_ptr()];
+        let values = [strings[1].as_ptr(), strings[3].as_ptr()];
+
+        unsafe {
+            let mut writer = 0u64;
+            assert_eq!(
+                nominal_create_channel_with_tags(stream, name.as_ptr(), keys.as_ptr(), values.as_ptr(), 2, &mut writer),
+                SUCCESS
+            );
+            let (_, tags) = channel_identity(writer);
+            let tag = |key: &str| tags.iter().find(|(k, _)| k == key).map(|(_, v)| v.as_str());
+            assert_eq!(tag("note"), Some("a=b,c"));
+            assert_eq!(tag("rig"), Some("7"));
+
+            // Same tags by CSV reuse the interned strings
+            let mut other = 0u64;
+            let csv = CString::new("rig=7").unwrap();
+            assert_eq!(nominal_create_channel(stream, name.as_ptr(), csv.as_ptr(), &mut other), SUCCESS);
+
+            let empty = CString::new("").unwrap();
+            let bad_keys = [empty.as_ptr()];
+            assert_eq!(
+                nominal_create_channel_with_tags(stream, name.as_ptr(), bad_keys.as_ptr(), values.as_ptr(), 1, &mut other),
+                ERROR_INVALID_PARAM
+            );
+        }
+    }
+
+    #[test]
+    fn test_default_tags() {
+        let fixture = TestStream::new("default_tags", "pressure");
+        let stream = fixture.stream;
+        let name = CString::new("pressure").unwrap();
+        let defaults = CString::new("rig=7,test=burn_in").unwrap();
+        let own = CString::new("test=soak,unit=psi").unwrap();
+        let tags_of = |writer: u64| {
+            let (_, mut tags) = channel_identity(writer);
+            tags.sort();
+            tags
+        };
+        let pair = |k: &str, v: &str| (k.to_string(), v.to_string());
+
+        unsafe {
+            assert_eq!(nominal_set_default_tags(stream, defaults.as_ptr()), SUCCESS);
+
+            let mut writers = [0u64; 3];
+            assert_eq!(nominal_create_channel(stream, name.as_ptr(), std::ptr::null(), &mut writers[0]), SUCCESS);
+            assert_eq!(nominal_create_channel(stream, name.as_ptr(), own.as_ptr(), &mut writers[1]), SUCCESS);
+            assert_eq!(tags_of(writers[0]), vec![pair("rig", "7"), pair("test", "burn_in")]);
+            assert_eq!(tags_of(writers[1]), vec![pair("rig", "7"), pair("test", "soak"), pair("unit", "psi")]);
+
+            // Clearing the defaults affects only channels created afterwards
+            assert_eq!(nominal_set_default_tags_with_tags(stream, std::ptr::null(), std::ptr::null(), 0), SUCCESS);
+            assert_eq!(nominal_create_channel(stream, name.as_ptr(), std::ptr::null(), &mut writers[2]), SUCCESS);
+            assert!(tags_of(writers[2]).is_empty());
+            assert_eq!(tags_of(writers[0]).len(), 2);
+
+            assert_eq!(nominal_set_default_tags(0, defaults.as_ptr()), ERROR_INVALID_HANDLE);
+        }
+    }
+
+    #[test]
+    fn test_get_or_create_channel() {
+        let fixture = TestStream::new("get_or_create", "pressure");
+        let stream = fixture.stream;
+        let name = CString::new("pressure").unwrap();
+        let tags = CString::new("rig=7,unit=psi").unwrap();
+        let reordered = CString::new("unit=psi,rig=7").unwrap();
+        let other = CString::new("rig=8,unit=psi").unwrap();
+
+        unsafe {
+            let mut first = 0u64;
+            let mut created = 9u32;
+            assert_eq!(
+                nominal_get_or_create_channel(stream, name.as_ptr(), tags.as_ptr(), &mut first, &mut created),
+                SUCCESS
+            );
+            assert_eq!(created, 1);
+
+            let mut writer = 0u64;
+            assert_eq!(
+                nominal_get_or_create_channel(stream, name.as_ptr(), reordered.as_ptr(), &mut writer, &mut created),
+                SUCCESS
+            );
+            assert_eq!((writer, created), (first, 0));
+
+            assert_eq!(
+                nominal_get_or_create_channel(stream, name.as_ptr(), other.as_ptr(), &mut writer, &mut created),
+                SUCCESS
+            );
+            assert_ne!(writer, first);
+            assert_eq!(created, 1);
+
+            // Channels from nominal_create_channel are found, and defaults
+            // count towards the key
+            assert_eq!(
+                nominal_get_or_create_channel(stream, name.as_ptr(), std::ptr::null(), &mut writer, std::ptr::null_mut()),
+                SUCCESS
+            );
+            assert_eq!(writer, fixture.writer);
+            let rig = CString::new("rig=7").unwrap();
+            let unit = CString::new("unit=psi").unwrap();
+            assert_eq!(nominal_set_default_tags(stream, rig.as_ptr()), SUCCESS);
+            assert_eq!(
+                nominal_get_or_create_channel(stream, name.as_ptr(), unit.as_ptr(), &mut writer, &mut created),
+                SUCCESS
+            );
+            assert_eq!((writer, created), (first, 0));
+
+            // A closed channel is replaced
+            assert_eq!(nominal_close_channel(first), SUCCESS);
+            assert_eq!(
+                nominal_get_or_create_channel(stream, name.as_ptr(), tags.as_ptr(), &mut writer, &mut created),
+                SUCCESS
+            );
+            assert_ne!(writer, first);
+            assert_eq!(created, 1);
+
+            // Closing a channel drops its index entry, so short-lived
+            // uniquely named channels don't pile up
+            let state = STREAMS.get(stream).unwrap();
+            let indexed = state.channel_index.read().len();
+            let once = fixture.channel("once");
+            assert_eq!(state.channel_index.read().len(), indexed + 1);
+            assert_eq!(nominal_close_channel(once), SUCCESS);
+            assert_eq!(state.channel_index.read().len(), indexed);
+
+            assert_eq!(
+                nominal_get_or_create_channel(0, name.as_ptr(), tags.as_ptr(), &mut writer, &mut created),
+                ERROR_INVALID_HANDLE
+            );
+            assert_eq!(nominal_shutdown_ex(stream, 2_000, std::ptr::null_mut()), SUCCESS);
+            assert!(state.channel_index.read().is_empty());
+        }
+    }
+
+    #[test]
+    fn test_backpressure_drop_oldest() {
+        let options = NominalStreamOptions {
+            struct_size: std::mem::size_of::<NominalStreamOptions>() as u64,
+            backpressure_policy: 2,
+            queue_capacity: 4,
+            ..Default::default()
+        };
+        let fixture = TestStream::with_options("drop_oldest", "vibration", &options);
+        let (stream, writer) = (fixture.stream, fixture.writer);
+
+        unsafe {
+            // A batch larger than the ring keeps only its newest points
+            let values = [0.0f64; 10];
+            assert_eq!(nominal_push_waveform(writer, 0, 1.0, values.as_ptr(), 10), SUCCESS);
+
+            let mut counters = NominalBackpressureCounters::default();
+            assert_eq!(nominal_get_backpressure_counters(stream, &mut counters), SUCCESS);
+            assert_eq!(counters.dropped_points, 6);
+            assert_eq!(counters.spilled_points, 0);
+        }
+    }
+
+    #[test]
+    fn test_backpressure_block_keeps_points() {
+        let options = NominalStreamOptions {
+            struct_size: std::mem::size_of::<NominalStreamOptions>() as u64,
+            backpressure_policy: 1,
+            queue_capacity: 4,
+            ..Default::default()
+        };
+        let fixture = TestStream::with_options("block", "vibration", &options);
+        let (stream, writer) = (fixture.stream, fixture.writer);
+
+        unsafe {
+            // A rejected batch stays with the caller, so it isn't counted as dropped
+            let values = [0.0f64; 10];
+            assert_eq!(nominal_push_waveform(writer, 0, 1.0, values.as_ptr(), 10), ERROR_QUEUE_FULL);
+
+            let mut counters = NominalBackpressureCounters::default();
+            assert_eq!(nominal_get_backpressure_counters(stream, &mut counters), SUCCESS);
+            assert_eq!(counters.block_timeouts, 1);
+            assert_eq!(counters.dropped_points, 0);
+        }
+    }
+
+    #[test]
+    fn test_configure_runtime_after_start_fails() {
+        Lazy::force(&RUNTIME);
+        let options = NominalRuntimeOptions {
+            struct_size: std::mem::size_of::<NominalRuntimeOptions>() as u64,
+            worker_threads: 1,
+            ..Default::default()
+        };
+        unsafe {
+            assert_eq!(nominal_configure_runtime(std::ptr::null()), ERROR_INVALID_PARAM);
+            assert_eq!(nominal_configure_runtime(&options), ERROR_RUNTIME);
+        }
+    }
+
+    #[test]
+    fn test_shutdown_ex_closes_channels() {
+        let fixture = TestStream::new("shutdown_ex", "a");
+        let writers = [fixture.writer, fixture.channel("b")];
+
+        unsafe {
+            assert_eq!(nominal_enable_async(writers[1], 16), SUCCESS);
+
+            let values = [1.0f64, 2.0, 3.0];
+            for &writer in &writers {
+                assert_eq!(nominal_push_waveform(writer, 0, 1.0, values.as_ptr(), 3), SUCCESS);
+            }
+
+            let mut report = NominalShutdownReport::default();
+            assert_eq!(nominal_shutdown_ex(fixture.stream, 2_000, &mut report), SUCCESS);
+            assert_eq!(report.points_sent, 6);
+            assert_eq!(report.points_lost, 0);
+            assert_eq!(report.channels_closed, 2);
+            assert_eq!(report.stream_closed, 1);
+
+            // Child handles were closed with the stream
+            assert_eq!(nominal_close_channel(writers[0]), ERROR_INVALID_HANDLE);
+            assert_eq!(nominal_shutdown_ex(fixture.stream, 0, std::ptr::null_mut()), ERROR_INVALID_HANDLE);
+
+            // With no time to close, nothing counts as sent unless the stream
+            // itself managed to close
+            let fixture = TestStream::new("shutdown_ex", "a");
+            let writers = [fixture.writer, fixture.channel("b")];
+            for &writer in &writers {
+                assert_eq!(nominal_push_waveform(writer, 0, 1.0, values.as_ptr(), 3), SUCCESS);
+            }
+            let mut report = NominalShutdownReport::default();
+            let result = nominal_shutdown_ex(fixture.stream, 0, &mut report);
+            assert_eq!(report.points_sent + report.points_lost, 6);
+            if report.stream_closed == 0 {
+                assert_eq!(result, ERROR_RUNTIME);
+                assert_eq!(report.points_sent, 0);
+            }
+        }
+    }
+
+    #[test]
+    fn test_flush() {
+        let fixture = TestStream::new("flush", "a");
+        let stream = fixture.stream;
+        let writers = [fixture.writer, fixture.channel("b")];
+
+        unsafe {
+            assert_eq!(nominal_enable_async(writers[1], 16), SUCCESS);
+
+            let values = [1.0f64, 2.0, 3.0];
+            for &writer in &writers {
+                assert_eq!(nominal_push_waveform(writer, 0, 1.0, values.as_ptr(), 3), SUCCESS);
+            }
+
+            assert_eq!(nominal_flush_channel(writers[0], 1_000), SUCCESS);
+            assert_eq!(nominal_flush_channel_async(writers[1]), SUCCESS);
+            assert_eq!(nominal_flush_stream(stream, 1_000), SUCCESS);
+            assert_eq!(nominal_flush_stream_async(stream), SUCCESS);
+
+            // Channels keep accepting points after a flush
+            assert_eq!(nominal_push_waveform(writers[1], 3, 1.0, values.as_ptr(), 3), SUCCESS);
+            assert_eq!(nominal_flush_stream(stream, 1_000), SUCCESS);
+
+            assert_eq!(nominal_flush_channel(0, 1_000), ERROR_INVALID_HANDLE);
+            assert_eq!(nominal_flush_stream_async(0), ERROR_INVALID_HANDLE);
+        }
+    }
+
+    #[test]
+    fn test_stats() {
+        let fixture = TestStream::new("stats", "a");
+        let writers = [fixture.writer, fixture.channel("b")];
+
+        unsafe {
+            assert_eq!(nominal_enable_async(writers[1], 16), SUCCESS);
+
+            let values = [1.0f64, 2.0, 3.0];
+            for &writer in &writers {
+                assert_eq!(nominal_push_waveform(writer, 0, 1.0, values.as_ptr(), 3), SUCCESS);
+                assert_eq!(nominal_push_waveform(writer, 3, 1.0, values.as_ptr(), 3), SUCCESS);
+            }
+            assert_eq!(nominal_flush_channel(writers[1], 1_000), SUCCESS);
+
+            let mut channel = NominalChannelStats {
+                struct_size: std::mem::size_of::<NominalChannelStats>() as u64,
+                ..Default::default()
+            };
+            assert_eq!(nominal_get_channel_stats(writers[1], &mut channel), SUCCESS);
+            assert_eq!(channel.points_accepted, 6);
+            assert_eq!(channel.bytes_accepted, 96);
+            assert_eq!(channel.queued_points, 0);
+            assert_eq!(channel.push_latency.count, 2);
+            assert!(channel.queue_latency.count >= 1);
+            assert_eq!(channel.flush_latency.count, 1);
+
+            // Closed channels still count toward the stream's totals
+            assert_eq!(nominal_close_channel(writers[0]), SUCCESS);
+            let mut totals = NominalStreamStats {
+                struct_size: std::mem::size_of::<NominalStreamStats>() as u64,
+                ..Default::default()
+            };
+            assert_eq!(nominal_get_stream_stats(fixture.stream, &mut totals), SUCCESS);
+            assert_eq!(totals.channels_open, 1);
+            assert_eq!(totals.points_accepted, 12);
+            assert_eq!(totals.push_latency.count, 4);
+
+            assert_eq!(nominal_get_channel_stats(writers[0], &mut channel), ERROR_INVALID_HANDLE);
+        }
+    }
+
+    #[test]
+    fn test_channel_compression() {
+        let fixture = TestStream::new("compression", "deadband");
+        let writers = [fixture.writer, fixture.channel("door")];
+        let stats_of = |writer: u64| {
+            let mut stats = NominalChannelStats {
+                struct_size: std::mem::size_of::<NominalChannelStats>() as u64,
+                ..Default::default()
+            };
+            assert_eq!(unsafe { nominal_get_channel_stats(writer, &mut stats) }, SUCCESS);
+            stats
+        };
+
+        unsafe {
+            assert_eq!(nominal_set_channel_compression(writers[0], 1, 0.5, 0, 0), SUCCESS);
+            assert_eq!(nominal_set_channel_compression(writers[1], 2, 1.0, 1, 0), SUCCESS);
+            assert_eq!(nominal_enable_async(writers[1], 16), SUCCESS);
+
+            // A flat 1 kHz signal with one step, as a waveform
+            let values: Vec<f64> = (0..1000).map(|i| if i < 500 { 20.0 } else { 25.0 }).collect();
+            for &writer in &writers {
+                assert_eq!(nominal_push_waveform(writer, 0, 1e6, values.as_ptr(), values.len()), SUCCESS);
+            }
+            let deadband = stats_of(writers[0]);
+            assert_eq!((deadband.points_accepted, deadband.points_suppressed), (2, 998));
+
+            // Swinging door holds the last point back until the flush; the
+            // step needs the points on both sides of it
+            assert_eq!(stats_of(writers[1]).points_accepted, 3);
+            assert_eq!(nominal_flush_channel(writers[1], 1_000), SUCCESS);
+            let door = stats_of(writers[1]);
+            assert_eq!((door.points_accepted, door.points_suppressed), (4, 996));
+
+            // Turning compression off passes every point through again
+            assert_eq!(nominal_set_channel_compression(writers[0], 0, 0.0, 0, 0), SUCCESS);
+            assert_eq!(nominal_push_waveform(writers[0], 1_000_000_000, 1e6, values.as_ptr(), 10), SUCCESS);
+            assert_eq!(stats_of(writers[0]).points_accepted, 12);
+
+            let mut totals = NominalStreamStats {
+                struct_size: std::mem::size_of::<NominalStreamStats>() as u64,
+                ..Default::default()
+            };
+            assert_eq!(nominal_get_stream_stats(fixture.stream, &mut totals), SUCCESS);
+            assert_eq!(totals.points_suppressed, 998 + 996);
+
+            // A batch the ring rejects leaves the compressor as it was: the
+            // rejected points mustn't become the deadband's reference
+            let ramp = [1.0, 5.0, 9.0, 13.0, 17.0];
+            let full = fixture.channel("full");
+            assert_eq!(nominal_set_channel_compression(full, 1, 0.5, 0, 0), SUCCESS);
+            assert_eq!(nominal_enable_async(full, 4), SUCCESS);
+            assert_eq!(nominal_push_waveform(full, 0, 1.0, ramp.as_ptr(), ramp.len()), ERROR_QUEUE_FULL);
+            assert_eq!(nominal_push_waveform(full, 5, 1.0, [17.2].as_ptr(), 1), SUCCESS);
+            let retried = stats_of(full);
+            assert_eq!((retried.points_accepted, retried.points_suppressed), (1, 0));
+
+            assert_eq!(nominal_set_channel_compression(writers[0], 3, 1.0, 0, 0), ERROR_INVALID_PARAM);
+            assert_eq!(nominal_set_channel_compression(writers[0], 1, -1.0, 0, 0), ERROR_INVALID_PARAM);
+            assert_eq!(nominal_set_channel_compression(0, 1, 1.0, 0, 0), ERROR_INVALID_HANDLE);
+        }
+    }
+
+    #[test]
+    fn test_spool_replays_leftover_segments() {
+        let dir = std::env::temp_dir().join("nominal_ffi_test_spool");
+        let _ = std::fs::remove_dir_all(&dir);
+        let path = std::env::temp_dir().join("nominal_ffi_test_spool.avro");
+        let path = CString::new(path.to_str().unwrap()).unwrap();
+        let dir_c = CString::new(dir.to_str().unwrap()).unwrap();
+        let rid = CString::new("ri.catalog.main.dataset.test").unwrap();
+        let name = CString::new("pressure").unwrap();
+
+        // A run that died with a sealed segment on disk
+        {
+            let spool = spool::Spool::open(dir.to_str().unwrap(), spool::SpoolConfig::default()).unwrap();
+            let mut writer = spool.writer("pressure", &[("rig", "7")]);
+            for i in 0..5000u64 {
+                writer.push(i, i as f64);
+            }
+            writer.seal();
+            std::mem::forget(writer);
+        }
+
+        let options = NominalStreamOptions {
+            struct_size: std::mem::size_of::<NominalStreamOptions>() as u64,
+            spool_replay_rate: 1_000_000_000,
+            ..Default::default()
+        };
+        let mut totals = NominalStreamStats {
+            struct_size: std::mem::size_of::<NominalStreamStats>() as u64,
+            ..Default::default()
+        };
+
+        unsafe {
+            let mut stream = 0u64;
+            assert_eq!(
+                nominal_init_spool(std::ptr::null(), rid.as_ptr(), path.as_ptr(), dir_c.as_ptr(), &options, &mut stream),
+                SUCCESS
+            );
+
+            // Live points spool alongside the replay
+            let mut writer = 0u64;
+            assert_eq!(nominal_create_channel(stream, name.as_ptr(), std::ptr::null(), &mut writer), SUCCESS);
+            let values = vec![1.0f64; 5000];
+            assert_eq!(nominal_push_waveform(writer, 10_000, 1.0, values.as_ptr(), values.len()), SUCCESS);
+            assert_eq!(nominal_flush_channel(writer, 1_000), SUCCESS);
+
+            let deadline = std::time::Instant::now() + Duration::from_secs(5);
+            loop {
+                assert_eq!(nominal_get_stream_stats(stream, &mut totals), SUCCESS);
+                if totals.spool_segments_pending == 0 || std::time::Instant::now() > deadline {
+                    break;
+                }
+                std::thread::sleep(Duration::from_millis(10));
+            }
+            assert_eq!(totals.spool_segments_pending, 0);
+            assert_eq!(totals.spool_replayed_points, 5000);
+            assert_eq!(totals.spool_segments_acked, 2);
+            assert_eq!(totals.spool_errors, 0);
+            assert_eq!((totals.spool_segments, totals.spool_bytes), (0, 0));
+
+            assert_eq!(nominal_shutdown_ex(stream, 2_000, std::ptr::null_mut()), SUCCESS);
+        }
+
+        // Everything was acked, so nothing is left to replay
+        assert_eq!(std::fs::read_dir(&dir).unwrap().count(), 0);
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_push_waveform() {
+        let fixture = TestStream::new("push_waveform", "temperature");
+        let values = [1.0f64, 2.0, 3.0];
+
+        unsafe {
+            assert_eq!(nominal_push_waveform(fixture.writer, 4_000, 1_000.0, values.as_ptr(), 3), SUCCESS);
+            assert_eq!(nominal_push_waveform(fixture.writer, 4_000, -1.0, values.as_ptr(), 3), ERROR_INVALID_PARAM);
+            assert_eq!(nominal_push_waveform(0, 4_000, 1_000.0, values.as_ptr(), 3), ERROR_INVALID_HANDLE);
+        }
+    }
+
+    #[test]
+    fn test_push_multi_double_batch() {
+        let fixture = TestStream::new("push_multi", "temperature");
+        let writer = fixture.writer;
+        let other = fixture.channel("temperature");
+        let timestamps = [1_000u64, 2_000, 3_000];
+        let matrix = [1.0f64, 2.0, 3.0, 4.0, 5.0, 6.0];
+
+        unsafe {
+            let handles = [writer, other];
+            assert_eq!(
+                nominal_push_multi_double_batch(handles.as_ptr(), 2, timestamps.as_ptr(), matrix.as_ptr(), 3),
+                SUCCESS
+            );
+            // A repeated handle would send that channel back in time
+            let repeated = [writer, writer];
+            assert_eq!(
+                nominal_push_multi_double_batch(repeated.as_ptr(), 2, timestamps.as_ptr(), matrix.as_ptr(), 3),
+                ERROR_INVALID_PARAM
+            );
+            let bad_handles = [writer, 0];
+            assert_eq!(
+                nominal_push_multi_double_batch(bad_handles.as_ptr(), 2, timestamps.as_ptr(), matrix.as_ptr(), 3),
+                ERROR_INVALID_HANDLE
+            );
+        }
+    }
+
+    #[test]
+    fn test_push_points() {
+        let fixture = TestStream::new("push_points", "temperature");
+        let timestamps = [1_000u64, 2_000, 3_000];
+        let values = [1.0f64, 2.0, 3.0];
+        let xy: Vec<PointXY> = timestamps
+            .iter()
+            .zip(values)
+            .map(|(&timestamp_ns, value)| PointXY { timestamp_ns, value })
+            .collect();
+        let yx: Vec<PointYX> = timestamps
+            .iter()
+            .zip(values)
+            .map(|(&timestamp_ns, value)| PointYX { value, timestamp_ns })
+            .collect();
+
+        unsafe {
+            assert_eq!(nominal_push_points_xy(fixture.writer, xy.as_ptr(), xy.len()), SUCCESS);
+            assert_eq!(nominal_push_points_yx(fixture.writer, yx.as_ptr(), yx.len()), SUCCESS);
+            assert_eq!(nominal_push_points_xy(0, xy.as_ptr(), xy.len()), ERROR_INVALID_HANDLE);
+        }
+    }
+
+    #[test]
+    fn test_push_scaled_raw() {
+        let fixture = TestStream::new("push_scaled_raw", "temperature");
+        let writer = fixture.writer;
+        let timestamps = [1_000u64, 2_000, 3_000];
+        let raw: [i16; 3] = [100, 200, 300];
+        let gain = [0.5f64, 0.01];
+
+        unsafe {
+            assert_eq!(nominal_set_channel_scale(writer, gain.as_ptr(), 2), SUCCESS);
+            assert_eq!(nominal_push_i16_batch(writer, timestamps.as_ptr(), raw.as_ptr(), 3), SUCCESS);
+            assert_eq!(nominal_set_channel_scale(writer, std::ptr::null(), 0), SUCCESS);
+            assert_eq!(nominal_push_i16_batch(writer, timestamps.as_ptr(), raw.as_ptr(), 3), SUCCESS);
+            assert_eq!(nominal_set_channel_scale(writer, gain.as_ptr(), 9), ERROR_INVALID_PARAM);
+        }
+    }
+
+    #[test]
+    fn test_writer_persists_across_pushes() {
+        let fixture = TestStream::new("writer_persists", "temperature");
+        let (stream, writer) = (fixture.stream, fixture.writer);
+
+        unsafe {
+            let timestamps = [1_000u64, 2_000, 3_000];
+            let values = [1.0f64, 2.0, 3.0];
+            for _ in 0..3 {
+                assert_eq!(
+                    nominal_push_double_batch(writer, timestamps.as_ptr(), values.as_ptr(), 3),
+                    SUCCESS
+                );
+            }
+
+            assert_eq!(nominal_close_channel(writer), SUCCESS);
+            assert_eq!(nominal_close_channel(writer), ERROR_INVALID_HANDLE);
+            assert_eq!(nominal_shutdown(stream), SUCCESS);
+        }
     }
 }
\ No newline at end of file
@@ -0,0 +1,375 @@
+//! Lock-free generational handle table.
+//!
+//! Handles are `u64`s that encode a slot index in the low 32 bits and the
+//! slot's generation in the high 32 bits. Removing an entry bumps the slot's
+//! generation, so a stale handle held by LabVIEW after a close is detected
+//! instead of silently addressing whatever reuses the slot.
+//!
+//! * `get` is wait-free: one atomic increment, one load, an `Arc` clone and one
+//!   atomic decrement, with no retry loop.
+//! * `insert` is lock-free: it pops a slot from a tagged Treiber free list or
+//!   bumps a fresh-slot counter, then publishes the value with one atomic op.
+//! * `remove` is lock-free against other writers and waits only for lookups
+//!   that are already in flight on the same slot to finish cloning.
+//!
+//! Slots live in fixed-size pages that are allocated on first use and never
+//! freed while the table is alive, so a slot's address is stable for readers.
+//! Each slot is padded to its own cache line, so lookups of different handles
+//! from different threads don't invalidate each other's lines.
+//!
+//! A lookup still writes to its own slot (the reader count) and to the `Arc`'s
+//! reference count when it clones the value. An epoch or hazard-pointer scheme
+//! would drop the first write but not the second, since callers need an owned
+//! `Arc`, so lookups of the same handle share those two lines either way.
+
+use std::cell::UnsafeCell;
+use std::ptr;
+use std::sync::atomic::{AtomicPtr, AtomicU32, AtomicU64, Ordering};
+use std::sync::Arc;
+
+const PAGE_BITS: u32 = 10;
+const PAGE_SIZE: usize = 1 << PAGE_BITS;
+const MAX_PAGES: usize = 1 << 12;
+
+/// Maximum number of live entries in one table (4M)
+pub const MAX_SLOTS: usize = PAGE_SIZE * MAX_PAGES;
+
+// Slot state layout: [ generation:32 | occupied:1 | readers:31 ]
+const OCCUPIED: u64 = 1 << 31;
+const READERS_MASK: u64 = OCCUPIED - 1;
+
+// Free-list head layout: [ tag:32 | index + 1:32 ], 0 in the low half = empty
+const EMPTY: u32 = 0;
+
+#[inline]
+fn state_generation(state: u64) -> u32 {
+    (state >> 32) as u32
+}
+
+#[inline]
+fn encode_handle(index: u32, generation: u32) -> u64 {
+    ((generation as u64) << 32) | (index as u64 + 1)
+}
+
+#[inline]
+fn decode_handle(handle: u64) -> Option<(u32, u32)> {
+    let low = handle as u32;
+    if low == 0 {
+        return None;
+    }
+    Some((low - 1, (handle >> 32) as u32))
+}
+
+/// Next generation for a slot, skipping 0 so a valid handle is never 0
+#[inline]
+fn next_generation(generation: u32) -> u32 {
+    match generation.wrapping_add(1) {
+        0 => 1,
+        g => g,
+    }
+}
+
+// Aligned to a cache line, see the module docs
+#[repr(align(64))]
+struct Slot<T> {
+    state: AtomicU64,
+    next_free: AtomicU32,
+    value: UnsafeCell<Option<Arc<T>>>,
+}
+
+impl<T> Slot<T> {
+    fn new() -> Self {
+        Self {
+            state: AtomicU64::new((1u64) << 32),
+            next_free: AtomicU32::new(EMPTY),
+            value: UnsafeCell::new(None),
+        }
+    }
+}
+
+type Page<T> = [Slot<T>; PAGE_SIZE];
+
+pub struct HandleTable<T> {
+    pages: Box<[AtomicPtr<Page<T>>]>,
+    next_fresh: AtomicU32,
+    free_head: AtomicU64,
+}
+
+// SAFETY: a slot's value is only written while its occupied bit is clear and no
+// reader that observed it occupied is still in flight, so shared access from
+// several threads only ever clones the `Arc`, which requires `T: Send + Sync`.
+unsafe impl<T: Send + Sync> Send for HandleTable<T> {}
+unsafe impl<T: Send + Sync> Sync for HandleTable<T> {}
+
+impl<T> HandleTable<T> {
+    pub fn new() -> Self {
+        let pages = (0..MAX_PAGES)
+            .map(|_| AtomicPtr::new(ptr::null_mut()))
+            .collect::<Vec<_>>()
+            .into_boxed_slice();
+        Self {
+            pages,
+            next_fresh: AtomicU32::new(0),
+            free_head: AtomicU64::new(0),
+        }
+    }
+
+    /// Slot at `index`, or `None` if its page was never allocated
+    #[inline]
+    fn slot(&self, index: u32) -> Option<&Slot<T>> {
+        let page = self.pages.get(index as usize >> PAGE_BITS)?.load(Ordering::Acquire);
+        if page.is_null() {
+            return None;
+        }
+        // SAFETY: pages are never freed while the table is alive
+        Some(unsafe { &(*page)[index as usize & (PAGE_SIZE - 1)] })
+    }
+
+    /// Slot at `index`, allocating its page if needed
+    fn slot_or_alloc(&self, index: u32) -> &Slot<T> {
+        let entry = &self.pages[index as usize >> PAGE_BITS];
+        let mut page = entry.load(Ordering::Acquire);
+        if page.is_null() {
+            let fresh: Box<Page<T>> = Box::new(std::array::from_fn(|_| Slot::new()));
+            let fresh = Box::into_raw(fresh);
+            match entry.compare_exchange(ptr::null_mut(), fresh, Ordering::AcqRel, Ordering::Acquire) {
+                Ok(_) => page = fresh,
+                Err(existing) => {
+                    // Another thread installed the page first
+                    drop(unsafe { Box::from_raw(fresh) });
+                    page = existing;
+                }
+            }
+        }
+        unsafe { &(*page)[index as usize & (PAGE_SIZE - 1)] }
+    }
+
+    fn pop_free(&self) -> Option<u32> {
+        let mut head = self.free_head.load(Ordering::Acquire);
+        loop {
+            let top = head as u32;
+            if top == EMPTY {
+                return None;
+            }
+            let index = top - 1;
+            let next = self.slot(index)?.next_free.load(Ordering::Acquire);
+            let tag = (head >> 32) as u32;
+            let new_head = ((tag.wrapping_add(1) as u64) << 32) | next as u64;
+            match self.free_head.compare_exchange_weak(head, new_head, Ordering::AcqRel, Ordering::Acquire) {
+                Ok(_) => return Some(index),
+                Err(current) => head = current,
+            }
+        }
+    }
+
+    fn push_free(&self, index: u32, slot: &Slot<T>) {
+        let mut head = self.free_head.load(Ordering::Acquire);
+        loop {
+            slot.next_free.store(head as u32, Ordering::Release);
+            let tag = (head >> 32) as u32;
+            let new_head = ((tag.wrapping_add(1) as u64) << 32) | (index as u64 + 1);
+            match self.free_head.compare_exchange_weak(head, new_head, Ordering::AcqRel, Ordering::Acquire) {
+                Ok(_) => return,
+                Err(current) => head = current,
+            }
+        }
+    }
+
+    /// Store `value` and return its handle, or `None` if the table is full
+    pub fn insert(&self, value: Arc<T>) -> Option<u64> {
+        let index = match self.pop_free() {
+            Some(index) => index,
+            None => {
+                let index = self.next_fresh.fetch_add(1, Ordering::Relaxed);
+                if index as usize >= MAX_SLOTS {
+                    self.next_fresh.fetch_sub(1, Ordering::Relaxed);
+                    return None;
+                }
+                index
+            }
+        };
+
+        let slot = self.slot_or_alloc(index);
+        // SAFETY: the slot is vacant and owned exclusively by this call. Stale
+        // lookups may bump the reader count, but they never read the value
+        // while the occupied bit is clear.
+        unsafe { *slot.value.get() = Some(value) };
+        let state = slot.state.fetch_or(OCCUPIED, Ordering::Release);
+
+        Some(encode_handle(index, state_generation(state)))
+    }
+
+    /// Store every value and return their handles in order, or store none of
+    /// them and return `None` if the table fills up part way
+    pub fn insert_all(&self, values: impl IntoIterator<Item = Arc<T>>) -> Option<Vec<u64>> {
+        let values = values.into_iter();
+        let mut handles = Vec::with_capacity(values.size_hint().0);
+        for value in values {
+            match self.insert(value) {
+                Some(handle) => handles.push(handle),
+                None => {
+                    for handle in handles {
+                        self.remove(handle);
+                    }
+                    return None;
+                }
+            }
+        }
+        Some(handles)
+    }
+
+    /// Look up a handle. Returns `None` for 0, unknown or stale handles.
+    #[inline]
+    pub fn get(&self, handle: u64) -> Option<Arc<T>> {
+        let (index, generation) = decode_handle(handle)?;
+        let slot = self.slot(index)?;
+
+        let state = slot.state.fetch_add(1, Ordering::Acquire);
+        let value = if state_generation(state) == generation && state & OCCUPIED != 0 {
+            // SAFETY: the slot is occupied by this generation and `remove`
+            // waits for our reader count to drop before taking the value.
+            unsafe { (*slot.value.get()).clone() }
+        } else {
+            None
+        };
+        slot.state.fetch_sub(1, Ordering::Release);
+        value
+    }
+
+    /// Remove a handle and return its value. Returns `None` for 0, unknown or
+    /// stale handles; the slot's generation is bumped so the handle stays
+    /// invalid once the slot is reused.
+    pub fn remove(&self, handle: u64) -> Option<Arc<T>> {
+        let (index, generation) = decode_handle(handle)?;
+        let slot = self.slot(index)?;
+
+        let mut state = slot.state.load(Ordering::Acquire);
+        loop {
+            if state_generation(state) != generation || state & OCCUPIED == 0 {
+                return None;
+            }
+            let vacated = ((next_generation(generation) as u64) << 32) | (state & READERS_MASK);
+            match slot.state.compare_exchange_weak(state, vacated, Ordering::AcqRel, Ordering::Acquire) {
+                Ok(_) => break,
+                Err(current) => state = current,
+            }
+        }
+
+        // Wait for lookups that may have observed the slot as occupied
+        while slot.state.load(Ordering::Acquire) & READERS_MASK != 0 {
+            std::hint::spin_loop();
+        }
+
+        // SAFETY: the slot is vacant and no reader is cloning the value
+        let value = unsafe { (*slot.value.get()).take() };
+        self.push_free(index, slot);
+        value
+    }
+
+    /// Snapshot of every live entry, for shutdown and reporting paths
+    pub fn values(&self) -> Vec<(u64, Arc<T>)> {
+        let fresh = self.next_fresh.load(Ordering::Acquire).min(MAX_SLOTS as u32);
+        let mut out = Vec::new();
+        for index in 0..fresh {
+            let Some(slot) = self.slot(index) else { continue };
+            let generation = state_generation(slot.state.load(Ordering::Acquire));
+            let handle = encode_handle(index, generation);
+            if let Some(value) = self.get(handle) {
+                out.push((handle, value));
+            }
+        }
+        out
+    }
+}
+
+impl<T> Default for HandleTable<T> {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl<T> Drop for HandleTable<T> {
+    fn drop(&mut self) {
+        for entry in self.pages.iter() {
+            let page = entry.load(Ordering::Acquire);
+            if !page.is_null() {
+                drop(unsafe { Box::from_raw(page) });
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_insert_get_remove() {
+        let table = HandleTable::new();
+        let h = table.insert(Arc::new(7u32)).unwrap();
+        assert_ne!(h, 0);
+        assert_eq!(*table.get(h).unwrap(), 7);
+        assert_eq!(*table.remove(h).unwrap(), 7);
+        assert!(table.get(h).is_none());
+        assert!(table.remove(h).is_none());
+    }
+
+    #[test]
+    fn test_stale_handle_detected_after_reuse() {
+        let table = HandleTable::new();
+        let h1 = table.insert(Arc::new(1u32)).unwrap();
+        table.remove(h1);
+        let h2 = table.insert(Arc::new(2u32)).unwrap();
+
+        // Same slot, different generation
+        assert_eq!(h1 as u32, h2 as u32);
+        assert_ne!(h1, h2);
+        assert!(table.get(h1).is_none());
+        assert_eq!(*table.get(h2).unwrap(), 2);
+    }
+
+    #[test]
+    fn test_insert_all() {
+        let table = HandleTable::new();
+        let handles = table.insert_all((0..100u32).map(Arc::new)).unwrap();
+        assert_eq!(handles.len(), 100);
+        for (i, &h) in handles.iter().enumerate() {
+            assert_eq!(*table.get(h).unwrap(), i as u32);
+        }
+        assert_eq!(table.insert_all(std::iter::empty()), Some(Vec::new()));
+    }
+
+    #[test]
+    fn test_slots_fill_cache_lines() {
+        assert_eq!(std::mem::size_of::<Slot<u32>>(), 64);
+    }
+
+    #[test]
+    fn test_invalid_handles() {
+        let table: HandleTable<u32> = HandleTable::new();
+        assert!(table.get(0).is_none());
+        assert!(table.get(u64::MAX).is_none());
+        assert!(table.remove(12345).is_none());
+    }
+
+    #[test]
+    fn test_concurrent_insert_remove() {
+        let table = Arc::new(HandleTable::new());
+        let threads: Vec<_> = (0..8)
+            .map(|t| {
+                let table = Arc::clone(&table);
+                std::thread::spawn(move || {
+                    for i in 0..2_000u32 {
+                        let h = table.insert(Arc::new(t * 10_000 + i)).unwrap();
+                        assert_eq!(*table.get(h).unwrap(), t * 10_000 + i);
+                        assert_eq!(*table.remove(h).unwrap(), t * 10_000 + i);
+                    }
+                })
+            })
+            .collect();
+        for t in threads {
+            t.join().unwrap();
+        }
+        assert!(table.values().is_empty());
+    }
+}
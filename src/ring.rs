@@ -0,0 +1,248 @@
+//! Fixed-capacity single-producer/single-consumer ring of points.
+//!
+//! The producer side is the LabVIEW thread calling a push function, and the
+//! consumer side is the channel's drain. Slots are allocated
+//! once up front. A push is a bounds check, a copy into the slots and one
+//! release store of the tail. There are no locks, syscalls or allocations.
+//!
+//! Callers must make sure only one thread produces and only one thread consumes
+//! at a time; `Channel` enforces this with its producer and consumer locks.
+
+use std::cell::UnsafeCell;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+/// Largest ring accepted, in points (64M points = 1 GiB)
+pub const MAX_CAPACITY: usize = 1 << 26;
+
+/// Keeps the producer and consumer indices on separate cache lines
+#[repr(align(64))]
+struct Padded(AtomicUsize);
+
+pub struct SpscRing {
+    slots: Box<[UnsafeCell<(u64, f64)>]>,
+    mask: usize,
+    // Next slot the consumer reads
+    head: Padded,
+    // Next slot the producer writes
+    tail: Padded,
+}
+
+// SAFETY: a slot is only written by the producer while it is outside
+// `head..tail`, and only read by the consumer while it is inside; the
+// release/acquire pairs on `head` and `tail` order those accesses.
+unsafe impl Send for SpscRing {}
+unsafe impl Sync for SpscRing {}
+
+impl SpscRing {
+    /// Create a ring holding at least `capacity` points (rounded up to a power of two)
+    pub fn new(capacity: usize) -> Result<Self, String> {
+        if capacity == 0 || capacity > MAX_CAPACITY {
+            return Err(format!(
+                "Ring capacity must be 1 to {} points, got {}",
+                MAX_CAPACITY, capacity
+            ));
+        }
+        let capacity = capacity.next_power_of_two();
+        let slots = (0..capacity)
+            .map(|_| UnsafeCell::new((0, 0.0)))
+            .collect::<Vec<_>>()
+            .into_boxed_slice();
+        Ok(Self {
+            slots,
+            mask: capacity - 1,
+            head: Padded(AtomicUsize::new(0)),
+            tail: Padded(AtomicUsize::new(0)),
+        })
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.mask + 1
+    }
+
+    /// Points currently queued
+    pub fn len(&self) -> usize {
+        let tail = self.tail.0.load(Ordering::Acquire);
+        let head = self.head.0.load(Ordering::Acquire);
+        tail.wrapping_sub(head)
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Start a producer batch. Writes become visible to the consumer when the
+    /// returned producer is committed.
+    ///
+    /// # Safety
+    /// Only one producer may exist at a time.
+    #[inline]
+    pub unsafe fn producer(&self) -> RingProducer<'_> {
+        let tail = self.tail.0.load(Ordering::Relaxed);
+        let head = self.head.0.load(Ordering::Acquire);
+        RingProducer {
+            ring: self,
+            tail,
+            limit: head.wrapping_add(self.capacity()),
+        }
+    }
+
+    /// Move up to `out.len()` of the oldest queued points into `out`. Returns
+    /// the number moved.
+    ///
+    /// # Safety
+    /// Only one consumer may run at a time.
+    pub unsafe fn take(&self, out: &mut [(u64, f64)]) -> usize {
+        let head = self.head.0.load(Ordering::Relaxed);
+        let tail = self.tail.0.load(Ordering::Acquire);
+        let n = out.len().min(tail.wrapping_sub(head));
+        for (i, point) in out[..n].iter_mut().enumerate() {
+            *point = *self.slots[head.wrapping_add(i) & self.mask].get();
+        }
+        self.head.0.store(head.wrapping_add(n), Ordering::Release);
+        n
+    }
+
+    /// Drop up to `n` of the oldest queued points. Returns the number dropped.
+    ///
+    /// # Safety
+    /// Only one consumer may run at a time.
+    pub unsafe fn discard(&self, n: usize) -> usize {
+        let head = self.head.0.load(Ordering::Relaxed);
+        let tail = self.tail.0.load(Ordering::Acquire);
+        let n = n.min(tail.wrapping_sub(head));
+        self.head.0.store(head.wrapping_add(n), Ordering::Release);
+        n
+    }
+}
+
+/// Uncommitted producer batch on a ring
+pub struct RingProducer<'a> {
+    ring: &'a SpscRing,
+    tail: usize,
+    limit: usize,
+}
+
+impl RingProducer<'_> {
+    /// Free slots left in this batch
+    #[inline]
+    pub fn remaining(&self) -> usize {
+        self.limit.wrapping_sub(self.tail)
+    }
+
+    /// Write one point. Returns false if the ring is full.
+    #[inline]
+    pub fn push(&mut self, timestamp_ns: u64, value: f64) -> bool {
+        if self.tail == self.limit {
+            return false;
+        }
+        // SAFETY: the slot is outside head..tail, so the consumer can't read it
+        unsafe { *self.ring.slots[self.tail & self.ring.mask].get() = (timestamp_ns, value) };
+        self.tail = self.tail.wrapping_add(1);
+        true
+    }
+
+    /// Publish the written points to the consumer
+    #[inline]
+    pub fn commit(self) {
+        self.ring.tail.0.store(self.tail, Ordering::Release);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::Arc;
+
+    #[test]
+    fn test_capacity_rounds_up() {
+        assert_eq!(SpscRing::new(1000).unwrap().capacity(), 1024);
+        assert!(SpscRing::new(0).is_err());
+        assert!(SpscRing::new(MAX_CAPACITY + 1).is_err());
+    }
+
+    #[test]
+    fn test_push_consume_wraps() {
+        let ring = SpscRing::new(4).unwrap();
+        let mut out = Vec::new();
+        for round in 0..3u64 {
+            let mut producer = unsafe { ring.producer() };
+            assert_eq!(producer.remaining(), 4);
+            for i in 0..3 {
+                assert!(producer.push(round * 10 + i, i as f64));
+            }
+            producer.commit();
+            assert_eq!(ring.len(), 3);
+            let mut taken = [(0, 0.0); 2];
+            while let n @ 1.. = unsafe { ring.take(&mut taken) } {
+                out.extend(taken[..n].iter().map(|&(t, _)| t));
+            }
+        }
+        assert_eq!(out, vec![0, 1, 2, 10, 11, 12, 20, 21, 22]);
+    }
+
+    #[test]
+    fn test_full_ring_rejects() {
+        let ring = SpscRing::new(2).unwrap();
+        let mut producer = unsafe { ring.producer() };
+        assert!(producer.push(1, 1.0));
+        assert!(producer.push(2, 2.0));
+        assert!(!producer.push(3, 3.0));
+        producer.commit();
+        assert_eq!(ring.len(), 2);
+    }
+
+    #[test]
+    fn test_discard_oldest() {
+        let ring = SpscRing::new(4).unwrap();
+        let mut producer = unsafe { ring.producer() };
+        for i in 0..4 {
+            producer.push(i, i as f64);
+        }
+        producer.commit();
+        assert_eq!(unsafe { ring.discard(3) }, 3);
+        assert_eq!(unsafe { ring.discard(3) }, 1);
+        assert!(ring.is_empty());
+    }
+
+    #[test]
+    fn test_uncommitted_points_are_invisible() {
+        let ring = SpscRing::new(4).unwrap();
+        let mut producer = unsafe { ring.producer() };
+        producer.push(1, 1.0);
+        drop(producer);
+        assert!(ring.is_empty());
+    }
+
+    #[test]
+    fn test_threaded_order() {
+        let ring = Arc::new(SpscRing::new(64).unwrap());
+        let consumer = {
+            let ring = Arc::clone(&ring);
+            std::thread::spawn(move || {
+                let mut expected = 0u64;
+                let mut taken = [(0, 0.0); 16];
+                while expected < 100_000 {
+                    let consumed = unsafe { ring.take(&mut taken) };
+                    for &(t, v) in &taken[..consumed] {
+                        assert_eq!(t, expected);
+                        assert_eq!(v, expected as f64);
+                        expected += 1;
+                    }
+                    if consumed == 0 {
+                        std::thread::yield_now();
+                    }
+                }
+            })
+        };
+        let mut next = 0u64;
+        while next < 100_000 {
+            let mut producer = unsafe { ring.producer() };
+            while next < 100_000 && producer.push(next, next as f64) {
+                next += 1;
+            }
+            producer.commit();
+            std::thread::yield_now();
+        }
+        consumer.join().unwrap();
+    }
+}
@@ -0,0 +1,337 @@
+//! Configuration of the library's Tokio runtime.
+//!
+//! The runtime is created on first use. Until then, `nominal_configure_runtime`
+//! can set how it is built, as often as needed. The settings are worker count
+//! or single-thread mode, CPU pinning, and scheduling priority. They keep the
+//! uploader off the cores that run deterministic LabVIEW loops.
+
+use once_cell::sync::OnceCell;
+use parking_lot::Mutex;
+use tokio::runtime::{Builder, Runtime};
+
+/// Worker threads used when no configuration is given
+pub const DEFAULT_WORKER_THREADS: usize = 4;
+
+/// Options for `nominal_configure_runtime`
+///
+/// Same conventions as `NominalStreamOptions`: every field is 8 bytes wide,
+/// `struct_size` gates which fields are read, and 0 selects the default.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct NominalRuntimeOptions {
+    pub struct_size: u64,
+    /// Worker threads for the multi-thread runtime (default 4)
+    pub worker_threads: u64,
+    /// Nonzero runs everything on one dedicated thread instead
+    pub current_thread: u64,
+    /// Bit `i` set allows runtime threads on CPU `i`; 0 leaves affinity alone
+    pub cpu_affinity_mask: u64,
+    /// 0 SCHED_OTHER, 1 SCHED_FIFO
+    pub sched_policy: u64,
+    /// Nice value (-20 to 19) for SCHED_OTHER, priority (1 to 99) for SCHED_FIFO
+    pub priority: i64,
+}
+
+impl NominalRuntimeOptions {
+    /// Read options from a caller-provided struct of any supported version
+    ///
+    /// # Safety
+    /// `options` must point to at least `struct_size` readable bytes.
+    pub unsafe fn read(options: *const NominalRuntimeOptions) -> Result<Self, String> {
+        let struct_size = std::ptr::read_unaligned(options as *const u64) as usize;
+        if struct_size < std::mem::size_of::<u64>() {
+            return Err(format!("Invalid options struct_size: {}", struct_size));
+        }
+        let mut parsed = NominalRuntimeOptions::default();
+        let len = struct_size.min(std::mem::size_of::<NominalRuntimeOptions>());
+        std::ptr::copy_nonoverlapping(
+            options as *const u8,
+            &mut parsed as *mut NominalRuntimeOptions as *mut u8,
+            len,
+        );
+        Ok(parsed)
+    }
+}
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum SchedPolicy {
+    Other { nice: i32 },
+    Fifo { priority: i32 },
+}
+
+/// Resolved runtime configuration
+#[derive(Clone, Debug)]
+pub struct RuntimeConfig {
+    pub worker_threads: usize,
+    pub current_thread: bool,
+    pub cpu_affinity_mask: u64,
+    pub sched: SchedPolicy,
+}
+
+impl Default for RuntimeConfig {
+    fn default() -> Self {
+        Self {
+            worker_threads: DEFAULT_WORKER_THREADS,
+            current_thread: false,
+            cpu_affinity_mask: 0,
+            sched: SchedPolicy::Other { nice: 0 },
+        }
+    }
+}
+
+impl RuntimeConfig {
+    pub fn from_options(options: &NominalRuntimeOptions) -> Result<Self, String> {
+        let sched = match (options.sched_policy, options.priority) {
+            (0, nice @ -20..=19) => SchedPolicy::Other { nice: nice as i32 },
+            (0, nice) => return Err(format!("Nice value must be -20 to 19, got {}", nice)),
+            (1, priority @ 1..=99) => SchedPolicy::Fifo {
+                priority: priority as i32,
+            },
+            (1, priority) => return Err(format!("SCHED_FIFO priority must be 1 to 99, got {}", priority)),
+            (policy, _) => return Err(format!("Invalid scheduling policy: {}", policy)),
+        };
+
+        let config = Self {
+            worker_threads: match options.worker_threads {
+                0 => DEFAULT_WORKER_THREADS,
+                n => n as usize,
+            },
+            current_thread: options.current_thread != 0,
+            cpu_affinity_mask: options.cpu_affinity_mask,
+            sched,
+        };
+
+        if !cfg!(target_os = "linux")
+            && (config.cpu_affinity_mask != 0 || config.sched != SchedPolicy::Other { nice: 0 })
+        {
+            return Err("CPU affinity and thread priority are only supported on Linux".to_string());
+        }
+
+        Ok(config)
+    }
+}
+
+static CONFIG: Mutex<ConfigState> = Mutex::new(ConfigState {
+    config: None,
+    built: false,
+});
+
+/// Configuration from nominal_configure_runtime, replaceable until the
+/// runtime is built with it
+struct ConfigState {
+    config: Option<RuntimeConfig>,
+    built: bool,
+}
+
+impl ConfigState {
+    fn set(&mut self, config: RuntimeConfig) -> Result<(), String> {
+        if self.built {
+            return Err("Runtime is already running; configure it before the first nominal_init".to_string());
+        }
+        self.config = Some(config);
+        Ok(())
+    }
+
+    /// Configuration to build with; fixed from now on
+    fn build(&mut self) -> RuntimeConfig {
+        self.built = true;
+        self.config.get_or_insert_with(RuntimeConfig::default).clone()
+    }
+
+    fn current(&self) -> RuntimeConfig {
+        self.config.clone().unwrap_or_default()
+    }
+}
+
+// First failure applying affinity or priority to a runtime thread
+static THREAD_SETUP_ERROR: OnceCell<String> = OnceCell::new();
+
+/// Store the configuration, replacing any earlier one. Fails once the
+/// runtime has been built.
+pub fn configure(config: RuntimeConfig) -> Result<(), String> {
+    CONFIG.lock().set(config)
+}
+
+/// Error from setting up a runtime thread, if any
+pub fn thread_setup_error() -> Option<&'static String> {
+    THREAD_SETUP_ERROR.get()
+}
+
+/// Build the runtime from the stored configuration (or the defaults)
+pub fn build() -> Runtime {
+    let config = CONFIG.lock().build();
+    let thread_config = config.clone();
+
+    let mut builder = if config.current_thread {
+        Builder::new_current_thread()
+    } else {
+        let mut b = Builder::new_multi_thread();
+        b.worker_threads(config.worker_threads);
+        b
+    };
+
+    builder
+        .thread_name("nominal-rt")
+        .on_thread_start(move || apply_thread_settings(&thread_config))
+        .enable_all()
+        .build()
+        .expect("Failed to create Tokio runtime")
+}
+
+/// Spawn the thread that drives a current-thread runtime, so spawned tasks
+/// make progress between FFI calls. Called while `RUNTIME` is initializing;
+/// the thread waits for that to finish before driving it.
+pub fn spawn_driver() {
+    if !CONFIG.lock().current().current_thread {
+        return;
+    }
+    spawn_thread("nominal-rt", || crate::RUNTIME.block_on(std::future::pending::<()>()))
+        .expect("Failed to spawn runtime driver thread");
+}
+
+/// Spawn a library thread outside the runtime, with the same affinity and
+/// priority as the runtime's threads
+pub fn spawn_thread<F>(name: &str, f: F) -> std::io::Result<std::thread::JoinHandle<()>>
+where
+    F: FnOnce() + Send + 'static,
+{
+    let config = CONFIG.lock().current();
+    std::thread::Builder::new().name(name.to_string()).spawn(move || {
+        apply_thread_settings(&config);
+        f()
+    })
+}
+
+fn apply_thread_settings(config: &RuntimeConfig) {
+    if let Err(e) = platform::apply(config) {
+        let _ = THREAD_SETUP_ERROR.set(e);
+    }
+}
+
+#[cfg(target_os = "linux")]
+mod platform {
+    use super::{RuntimeConfig, SchedPolicy};
+
+    pub fn apply(config: &RuntimeConfig) -> Result<(), String> {
+        unsafe {
+            if config.cpu_affinity_mask != 0 {
+                let mut set: libc::cpu_set_t = std::mem::zeroed();
+                for cpu in 0..64 {
+                    if config.cpu_affinity_mask & (1 << cpu) != 0 {
+                        libc::CPU_SET(cpu, &mut set);
+                    }
+                }
+                if libc::sched_setaffinity(0, std::mem::size_of::<libc::cpu_set_t>(), &set) != 0 {
+                    return Err(format!(
+                        "sched_setaffinity({:#x}) failed: {}",
+                        config.cpu_affinity_mask,
+                        std::io::Error::last_os_error()
+                    ));
+                }
+            }
+
+            match config.sched {
+                SchedPolicy::Other { nice: 0 } => {}
+                SchedPolicy::Other { nice } => {
+                    // Linux applies a tid's nice value to that thread only
+                    let tid = libc::syscall(libc::SYS_gettid) as libc::id_t;
+                    if libc::setpriority(libc::PRIO_PROCESS, tid, nice) != 0 {
+                        return Err(format!(
+                            "setpriority(nice {}) failed: {}",
+                            nice,
+                            std::io::Error::last_os_error()
+                        ));
+                    }
+                }
+                SchedPolicy::Fifo { priority } => {
+                    let param = libc::sched_param {
+                        sched_priority: priority,
+                    };
+                    let rc = libc::pthread_setschedparam(libc::pthread_self(), libc::SCHED_FIFO, &param);
+                    if rc != 0 {
+                        return Err(format!(
+                            "pthread_setschedparam(SCHED_FIFO, {}) failed: {}",
+                            priority,
+                            std::io::Error::from_raw_os_error(rc)
+                        ));
+                    }
+                }
+            }
+        }
+        Ok(())
+    }
+}
+
+#[cfg(not(target_os = "linux"))]
+mod platform {
+    use super::RuntimeConfig;
+
+    // RuntimeConfig::from_options rejects affinity and priority off Linux
+    pub fn apply(_config: &RuntimeConfig) -> Result<(), String> {
+        Ok(())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_options_layout() {
+        assert_eq!(std::mem::size_of::<NominalRuntimeOptions>(), 48);
+    }
+
+    #[test]
+    fn test_defaults() {
+        let options = NominalRuntimeOptions {
+            struct_size: 48,
+            ..Default::default()
+        };
+        let config = RuntimeConfig::from_options(&options).unwrap();
+        assert_eq!(config.worker_threads, DEFAULT_WORKER_THREADS);
+        assert!(!config.current_thread);
+        assert_eq!(config.sched, SchedPolicy::Other { nice: 0 });
+    }
+
+    #[test]
+    fn test_reconfigure_until_built() {
+        let mut state = ConfigState {
+            config: None,
+            built: false,
+        };
+        let single = RuntimeConfig {
+            current_thread: true,
+            ..Default::default()
+        };
+        state.set(RuntimeConfig::default()).unwrap();
+        state.set(single.clone()).unwrap();
+        assert!(state.build().current_thread);
+        assert!(state.set(RuntimeConfig::default()).is_err());
+        assert!(state.current().current_thread);
+    }
+
+    #[test]
+    fn test_invalid_priorities() {
+        let fifo_zero = NominalRuntimeOptions {
+            struct_size: 48,
+            sched_policy: 1,
+            priority: 0,
+            ..Default::default()
+        };
+        assert!(RuntimeConfig::from_options(&fifo_zero).is_err());
+
+        let bad_nice = NominalRuntimeOptions {
+            struct_size: 48,
+            priority: 25,
+            ..Default::default()
+        };
+        assert!(RuntimeConfig::from_options(&bad_nice).is_err());
+
+        let bad_policy = NominalRuntimeOptions {
+            struct_size: 48,
+            sched_policy: 7,
+            ..Default::default()
+        };
+        assert!(RuntimeConfig::from_options(&bad_policy).is_err());
+    }
+}
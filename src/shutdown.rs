@@ -0,0 +1,96 @@
+//! Deadline-bounded stream shutdown for `nominal_shutdown_ex`.
+//!
+//! Every channel is closed concurrently on the runtime. Closing a channel
+//! drains its async ring and then drops its writer, which flushes into the
+//! stream. After that the stream itself is dropped, which sends or writes to
+//! fallback whatever it still buffers. Everything is bounded by one deadline.
+//! Work that misses the deadline keeps running in the background, but the
+//! report counts its points as lost. Points only count as sent once the
+//! stream itself has closed, since until then they may sit in its buffers.
+
+use crate::channel::Channel;
+use crate::stream::StreamState;
+use std::sync::atomic::Ordering;
+use std::sync::Arc;
+use std::time::Duration;
+use tokio::task::JoinSet;
+use tokio::time::Instant;
+
+/// Outcome of `nominal_shutdown_ex`
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct NominalShutdownReport {
+    /// Points flushed into the stream by channels that closed in time, and
+    /// then sent or written to fallback by the stream closing in time
+    pub points_sent: u64,
+    /// Points the backpressure policy wrote to the spill file
+    pub points_spilled: u64,
+    /// Points dropped by the backpressure policy, plus points still held by
+    /// channels or by the stream at the deadline
+    pub points_lost: u64,
+    pub channels_closed: u64,
+    pub channels_timed_out: u64,
+    /// 1 if the stream finished flushing its own buffers before the deadline
+    pub stream_closed: u64,
+}
+
+pub(crate) async fn shutdown(
+    stream: Arc<StreamState>,
+    channels: Vec<Arc<Channel>>,
+    deadline: Duration,
+) -> NominalShutdownReport {
+    let deadline = Instant::now() + deadline;
+    let mut report = NominalShutdownReport::default();
+
+    // Close every channel in parallel, remembering how many points each held
+    let mut tasks = JoinSet::new();
+    let mut accepted: u64 = 0;
+    for channel in channels {
+        accepted += channel.stats.points_accepted.load(Ordering::Relaxed);
+        tasks.spawn(async move {
+            channel.close_async().await;
+            let points = channel.stats.points_accepted.load(Ordering::Relaxed);
+            // Dropping the writer flushes it; that is blocking work
+            let _ = tokio::task::spawn_blocking(move || drop(channel)).await;
+            points
+        });
+    }
+    let total_channels = tasks.len() as u64;
+
+    let channels_done = tokio::time::timeout_at(deadline, async {
+        while let Some(result) = tasks.join_next().await {
+            if let Ok(points) = result {
+                report.points_sent += points;
+                report.channels_closed += 1;
+            }
+        }
+    })
+    .await
+    .is_ok();
+
+    if !channels_done {
+        // Unfinished closes keep running detached; their points are unconfirmed
+        report.channels_timed_out = total_channels - report.channels_closed;
+        tasks.detach_all();
+    }
+
+    let counters = stream.counters.snapshot();
+    report.points_spilled = counters.spilled_points;
+    report.points_lost = counters.dropped_points;
+
+    // Drop the stream last so it flushes everything the channels handed it.
+    // Unfinished channels still hold a reference, in which case it closes
+    // whenever they do.
+    if channels_done {
+        let closed = tokio::task::spawn_blocking(move || drop(stream));
+        report.stream_closed = matches!(tokio::time::timeout_at(deadline, closed).await, Ok(Ok(()))) as u64;
+    }
+    if report.stream_closed == 0 {
+        // Whatever the channels handed over may still be in the stream's
+        // buffers, so none of it is confirmed
+        report.points_lost += accepted;
+        report.points_sent = 0;
+    }
+
+    report
+}
@@ -0,0 +1,818 @@
+//! Local disk spool for streams opened with `nominal_init_spool`.
+//!
+//! Every point a channel hands to its writer is also appended to a segment
+//! file for that channel in the spool directory. Points are written to the
+//! file at the end of each push call (each drain chunk in async mode), so
+//! they survive the process dying. A segment is sealed (synced to disk) when
+//! it reaches the configured size or the channel is flushed; until then,
+//! power loss can take what the OS hasn't written back yet.
+//!
+//! Once the channel's writer has handed its points to the stream, the segment
+//! is acknowledged by deleting it. That is a hand-off, not a confirmed
+//! upload: nominal-streaming doesn't report when Core accepts a batch, so
+//! points still in the stream's buffers or in flight when the process dies
+//! are in neither place. The spool covers points not yet handed over.
+//!
+//! Segments found in the directory when a stream opens were left by a run
+//! that didn't finish, for example after a crash or power loss. A background
+//! thread replays them into the stream at a limited rate, alongside live
+//! data, and deletes each one once it is handed over.
+//!
+//! Segment layout, little-endian:
+//!
+//! ```text
+//! "NOMSPL01" | name_len: u32 | name | tag_count: u32 | (len: u32, bytes) x 2 per tag
+//! records:   count: u32 | fnv1a32(points): u32 | count x (timestamp_ns: u64, value: f64)
+//! ```
+//!
+//! A torn or corrupt record ends a segment's replay. Replay is at-least-once:
+//! a segment interrupted by shutdown is replayed from the start next time.
+//!
+//! Disk use can be capped with a maximum segment count. When a new segment
+//! would go over it, the oldest segments that no channel is writing to are
+//! deleted, leftovers from earlier runs first, and counted as evicted, along
+//! with how many points they held and the span of their timestamps. The
+//! span of a leftover segment is read from it when the spool opens. On
+//! Linux, segments can be preallocated to their full size with `fallocate`,
+//! so a full disk shows up when a segment is opened rather than part way
+//! through a record; the unused tail is released when the segment is sealed.
+
+use crate::channel::{descriptor, WriterState};
+use crate::runtime;
+use nominal_streaming::stream::NominalDatasetStream;
+use parking_lot::Mutex;
+use std::fs::{self, File, OpenOptions};
+use std::io::{self, BufReader, ErrorKind, Read, Write};
+use std::collections::BTreeMap;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::Arc;
+use std::thread::JoinHandle;
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
+
+/// Segment size used when no size is given
+pub const DEFAULT_SEGMENT_BYTES: u64 = 64 << 20;
+
+/// Replay rate used when no rate is given, in points per second
+pub const DEFAULT_REPLAY_RATE: u64 = 100_000;
+
+/// Segment size, replay rate and disk cap of a spool
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub struct SpoolConfig {
+    pub segment_bytes: u64,
+    pub replay_rate: u64,
+    /// Most segments kept on disk; 0 for no cap
+    pub max_segments: u64,
+    /// Reserve each segment's full size on disk when it is opened
+    pub preallocate: bool,
+}
+
+impl Default for SpoolConfig {
+    fn default() -> Self {
+        Self {
+            segment_bytes: DEFAULT_SEGMENT_BYTES,
+            replay_rate: DEFAULT_REPLAY_RATE,
+            max_segments: 0,
+            preallocate: false,
+        }
+    }
+}
+
+const MAGIC: &[u8; 8] = b"NOMSPL01";
+const SEGMENT_EXTENSION: &str = "seg";
+// Most points per record; a push call that ends sooner writes a shorter one
+const RECORD_POINTS: usize = 4096;
+const POINT_BYTES: usize = 16;
+const MAX_NAME_BYTES: usize = 64 << 10;
+
+/// Spool progress, reported through `nominal_get_stream_stats`
+pub struct SpoolCounters {
+    pub segments_acked: AtomicU64,
+    pub segments_pending_replay: AtomicU64,
+    pub replayed_points: AtomicU64,
+    pub write_errors: AtomicU64,
+    /// Segments deleted unsent to stay under the segment cap
+    pub segments_evicted: AtomicU64,
+    /// Points in the evicted segments
+    pub points_evicted: AtomicU64,
+    /// Earliest and latest timestamp in the evicted segments; `u64::MAX` and
+    /// 0 until something is evicted
+    pub evicted_first_ns: AtomicU64,
+    pub evicted_last_ns: AtomicU64,
+}
+
+impl Default for SpoolCounters {
+    fn default() -> Self {
+        Self {
+            segments_acked: AtomicU64::new(0),
+            segments_pending_replay: AtomicU64::new(0),
+            replayed_points: AtomicU64::new(0),
+            write_errors: AtomicU64::new(0),
+            segments_evicted: AtomicU64::new(0),
+            points_evicted: AtomicU64::new(0),
+            evicted_first_ns: AtomicU64::new(u64::MAX),
+            evicted_last_ns: AtomicU64::new(0),
+        }
+    }
+}
+
+impl SpoolCounters {
+    /// Span of timestamps lost to eviction, or zeros if nothing was evicted
+    pub fn evicted_span(&self) -> (u64, u64) {
+        let first = self.evicted_first_ns.load(Ordering::Relaxed);
+        let last = self.evicted_last_ns.load(Ordering::Relaxed);
+        if first > last {
+            (0, 0)
+        } else {
+            (first, last)
+        }
+    }
+}
+
+/// Disk space taken by one segment, and the points it holds
+struct SegmentUsage {
+    bytes: u64,
+    // A channel is still appending to it, so it can't be evicted
+    open: bool,
+    points: PointSpan,
+}
+
+/// Count and timestamp span of a set of points
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+struct PointSpan {
+    count: u64,
+    first_ns: u64,
+    last_ns: u64,
+}
+
+impl PointSpan {
+    const EMPTY: Self = Self {
+        count: 0,
+        first_ns: u64::MAX,
+        last_ns: 0,
+    };
+
+    /// Add a record's worth of encoded points
+    fn add_record(&mut self, points: &[u8]) {
+        for point in points.chunks_exact(POINT_BYTES) {
+            let timestamp = u64::from_le_bytes(point[..8].try_into().unwrap());
+            self.first_ns = self.first_ns.min(timestamp);
+            self.last_ns = self.last_ns.max(timestamp);
+        }
+        self.count += (points.len() / POINT_BYTES) as u64;
+    }
+
+    fn merge(&mut self, other: PointSpan) {
+        self.count += other.count;
+        self.first_ns = self.first_ns.min(other.first_ns);
+        self.last_ns = self.last_ns.max(other.last_ns);
+    }
+}
+
+pub(crate) struct Spool {
+    dir: PathBuf,
+    config: SpoolConfig,
+    // Prefix of this run's segment names, so they never collide with leftovers
+    run_id: String,
+    next_segment: AtomicU64,
+    closed: AtomicBool,
+    replay: Mutex<Option<JoinHandle<()>>>,
+    // Every segment on disk; names sort oldest first
+    segments: Mutex<BTreeMap<PathBuf, SegmentUsage>>,
+    pub(crate) counters: SpoolCounters,
+}
+
+impl Spool {
+    pub(crate) fn open(dir: &str, config: SpoolConfig) -> io::Result<Arc<Self>> {
+        fs::create_dir_all(dir)?;
+        let run_id = SystemTime::now()
+            .duration_since(UNIX_EPOCH)
+            .unwrap_or_default()
+            .as_nanos();
+        // Leftovers from earlier runs count towards the cap too
+        let mut segments = BTreeMap::new();
+        for entry in fs::read_dir(dir)? {
+            let entry = entry?;
+            let path = entry.path();
+            if path.extension().map_or(false, |ext| ext == SEGMENT_EXTENSION) {
+                let bytes = entry.metadata().map_or(0, |m| m.len());
+                // An unreadable header is dealt with by replay
+                let points = segment_span(&path).unwrap_or(PointSpan::EMPTY);
+                segments.insert(path, SegmentUsage { bytes, open: false, points });
+            }
+        }
+        Ok(Arc::new(Self {
+            dir: PathBuf::from(dir),
+            config,
+            run_id: format!("{:032x}", run_id),
+            next_segment: AtomicU64::new(0),
+            closed: AtomicBool::new(false),
+            replay: Mutex::new(None),
+            segments: Mutex::new(segments),
+            counters: SpoolCounters::default(),
+        }))
+    }
+
+    /// Start replaying segments left by earlier runs into `stream`
+    pub(crate) fn start_replay(self: &Arc<Self>, stream: Arc<NominalDatasetStream>) -> io::Result<()> {
+        // Names start with the run id, so this replays oldest first
+        let segments: Vec<PathBuf> = self
+            .segments
+            .lock()
+            .keys()
+            .filter(|path| !self.is_own_segment(path))
+            .cloned()
+            .collect();
+        if segments.is_empty() {
+            return Ok(());
+        }
+        self.counters
+            .segments_pending_replay
+            .store(segments.len() as u64, Ordering::Relaxed);
+
+        let spool = Arc::clone(self);
+        let thread = runtime::spawn_thread("nominal-spool", move || spool.replay(&stream, segments))?;
+        *self.replay.lock() = Some(thread);
+        Ok(())
+    }
+
+    /// Stop replay, leaving unfinished segments for the next run
+    pub(crate) fn close(&self) {
+        self.closed.store(true, Ordering::Release);
+        if let Some(thread) = self.replay.lock().take() {
+            let _ = thread.join();
+        }
+    }
+
+    /// Spool writer for one channel
+    pub(crate) fn writer(self: &Arc<Self>, name: &str, tags: &[(&str, &str)]) -> SpoolWriter {
+        let mut header = MAGIC.to_vec();
+        put_bytes(&mut header, name.as_bytes());
+        header.extend_from_slice(&(tags.len() as u32).to_le_bytes());
+        for (key, value) in tags {
+            put_bytes(&mut header, key.as_bytes());
+            put_bytes(&mut header, value.as_bytes());
+        }
+        SpoolWriter {
+            spool: Arc::clone(self),
+            header,
+            segment: None,
+            pending: Vec::with_capacity(RECORD_POINTS * POINT_BYTES),
+            unacked: Vec::new(),
+            failed: false,
+        }
+    }
+
+    /// Segments on disk and the bytes they take up, counting the full size of
+    /// preallocated segments still open
+    pub(crate) fn usage(&self) -> (u64, u64) {
+        let segments = self.segments.lock();
+        (segments.len() as u64, segments.values().map(|s| s.bytes).sum())
+    }
+
+    /// Create a segment file, then evict the oldest closed segments until the
+    /// spool is back under its cap
+    fn create_segment(&self) -> io::Result<(PathBuf, File)> {
+        let path = self.new_segment_path();
+        let file = OpenOptions::new().create_new(true).append(true).open(&path)?;
+        // Preallocation is best effort; not every filesystem supports it
+        let bytes = if self.config.preallocate && preallocate(&file, self.config.segment_bytes).is_ok() {
+            self.config.segment_bytes
+        } else {
+            0
+        };
+
+        let mut evict = Vec::new();
+        {
+            let mut segments = self.segments.lock();
+            let usage = SegmentUsage {
+                bytes,
+                open: true,
+                points: PointSpan::EMPTY,
+            };
+            segments.insert(path.clone(), usage);
+            if self.config.max_segments > 0 {
+                let excess = segments.len().saturating_sub(self.config.max_segments as usize);
+                evict.extend(
+                    segments
+                        .iter()
+                        .filter(|(_, s)| !s.open)
+                        .map(|(p, s)| (p.clone(), s.points))
+                        .take(excess),
+                );
+            }
+        }
+        for (old, points) in evict {
+            if self.remove_segment(&old) {
+                let counters = &self.counters;
+                counters.segments_evicted.fetch_add(1, Ordering::Relaxed);
+                counters.points_evicted.fetch_add(points.count, Ordering::Relaxed);
+                counters.evicted_first_ns.fetch_min(points.first_ns, Ordering::Relaxed);
+                counters.evicted_last_ns.fetch_max(points.last_ns, Ordering::Relaxed);
+            }
+        }
+        Ok((path, file))
+    }
+
+    /// Record a segment's new length, and the points added, after a write
+    fn segment_grew(&self, path: &Path, len: u64, points: PointSpan) {
+        if let Some(usage) = self.segments.lock().get_mut(path) {
+            usage.bytes = usage.bytes.max(len);
+            usage.points.merge(points);
+        }
+    }
+
+    /// Record that a segment has been sealed at `len` bytes
+    fn segment_sealed(&self, path: &Path, len: u64) {
+        if let Some(usage) = self.segments.lock().get_mut(path) {
+            usage.bytes = len;
+            usage.open = false;
+        }
+    }
+
+    /// Delete a segment. Returns false if it was already gone, for example
+    /// because it was evicted, or couldn't be deleted.
+    fn remove_segment(&self, path: &Path) -> bool {
+        if !self.segments.lock().contains_key(path) || fs::remove_file(path).is_err() {
+            return false;
+        }
+        self.segments.lock().remove(path);
+        true
+    }
+
+    fn is_own_segment(&self, path: &Path) -> bool {
+        path.file_name()
+            .and_then(|name| name.to_str())
+            .map_or(false, |name| name.starts_with(&self.run_id))
+    }
+
+    fn new_segment_path(&self) -> PathBuf {
+        let index = self.next_segment.fetch_add(1, Ordering::Relaxed);
+        self.dir
+            .join(format!("{}-{:08x}.{}", self.run_id, index, SEGMENT_EXTENSION))
+    }
+
+    fn replay(&self, stream: &Arc<NominalDatasetStream>, segments: Vec<PathBuf>) {
+        let start = Instant::now();
+        let mut sent = 0u64;
+        for path in segments {
+            // Skip segments evicted to make room since replay started
+            if !self.segments.lock().contains_key(&path) {
+                self.counters
+                    .segments_pending_replay
+                    .fetch_sub(1, Ordering::Relaxed);
+                continue;
+            }
+            match self.replay_segment(stream, &path, start, &mut sent) {
+                Ok(true) => {
+                    if self.remove_segment(&path) {
+                        self.counters.segments_acked.fetch_add(1, Ordering::Relaxed);
+                    }
+                }
+                // Closed part way through; the segment stays for the next run
+                Ok(false) => return,
+                Err(_) => {
+                    // Unreadable header: set it aside rather than retry it forever
+                    self.counters.write_errors.fetch_add(1, Ordering::Relaxed);
+                    let _ = fs::rename(&path, path.with_extension("bad"));
+                    self.segments.lock().remove(&path);
+                }
+            }
+            self.counters
+                .segments_pending_replay
+                .fetch_sub(1, Ordering::Relaxed);
+        }
+    }
+
+    /// Push one segment's points into a writer of their own. Returns false if
+    /// the spool was closed first.
+    fn replay_segment(
+        &self,
+        stream: &Arc<NominalDatasetStream>,
+        path: &Path,
+        start: Instant,
+        sent: &mut u64,
+    ) -> io::Result<bool> {
+        let mut reader = BufReader::new(File::open(path)?);
+        let (name, tags) = read_header(&mut reader)?;
+        let tags: Vec<(&str, &str)> = tags.iter().map(|(k, v)| (k.as_str(), v.as_str())).collect();
+        // Dropping the writer at the end flushes the segment's points
+        let mut state = WriterState::new(Arc::clone(stream), Arc::new(descriptor(&name, &tags)));
+
+        let mut points = Vec::with_capacity(RECORD_POINTS * POINT_BYTES);
+        while read_record(&mut reader, &mut points) {
+            for point in points.chunks_exact(POINT_BYTES) {
+                let timestamp = u64::from_le_bytes(point[..8].try_into().unwrap());
+                let value = f64::from_bits(u64::from_le_bytes(point[8..].try_into().unwrap()));
+                state.push(timestamp, value);
+            }
+            let count = (points.len() / POINT_BYTES) as u64;
+            *sent += count;
+            self.counters.replayed_points.fetch_add(count, Ordering::Relaxed);
+            if !self.pace(start, *sent) {
+                return Ok(false);
+            }
+        }
+        Ok(true)
+    }
+
+    /// Sleep until `sent` points are due at the replay rate. Returns false if
+    /// the spool is closed meanwhile.
+    fn pace(&self, start: Instant, sent: u64) -> bool {
+        let due = start + Duration::from_secs_f64(sent as f64 / self.config.replay_rate as f64);
+        loop {
+            if self.closed.load(Ordering::Acquire) {
+                return false;
+            }
+            let now = Instant::now();
+            if now >= due {
+                return true;
+            }
+            std::thread::sleep((due - now).min(Duration::from_millis(100)));
+        }
+    }
+}
+
+/// One channel's open segment and the points not yet written to it
+pub(crate) struct SpoolWriter {
+    spool: Arc<Spool>,
+    header: Vec<u8>,
+    segment: Option<(PathBuf, File, u64)>,
+    pending: Vec<u8>,
+    // Sealed segments whose points the stream may not have yet
+    unacked: Vec<PathBuf>,
+    // Set after a write error; the channel keeps streaming without the spool
+    failed: bool,
+}
+
+impl SpoolWriter {
+    /// Record one point. Returns true when the segment is full and should be
+    /// sealed.
+    #[inline]
+    pub(crate) fn push(&mut self, timestamp_ns: u64, value: f64) -> bool {
+        if self.failed {
+            return false;
+        }
+        self.pending.extend_from_slice(&timestamp_ns.to_le_bytes());
+        self.pending.extend_from_slice(&value.to_bits().to_le_bytes());
+        if self.pending.len() < RECORD_POINTS * POINT_BYTES {
+            return false;
+        }
+        self.write_pending();
+        matches!(self.segment, Some((_, _, len)) if len >= self.spool.config.segment_bytes)
+    }
+
+    /// Write out the points buffered so far, without syncing. Returns true
+    /// when the segment is full and should be sealed.
+    pub(crate) fn write_through(&mut self) -> bool {
+        if self.pending.is_empty() {
+            return false;
+        }
+        self.write_pending();
+        matches!(self.segment, Some((_, _, len)) if len >= self.spool.config.segment_bytes)
+    }
+
+    /// Write out buffered points and sync the segment to disk
+    pub(crate) fn seal(&mut self) {
+        self.write_pending();
+        if let Some((path, file, len)) = self.segment.take() {
+            // Truncating to the written length releases any preallocated tail
+            if self.spool.config.preallocate && file.set_len(len).is_err() {
+                self.fail();
+            }
+            if file.sync_data().is_err() {
+                self.fail();
+            }
+            self.spool.segment_sealed(&path, len);
+            self.unacked.push(path);
+        }
+    }
+
+    /// The stream's buffers now hold every point in the sealed segments
+    pub(crate) fn ack(&mut self) {
+        for path in self.unacked.drain(..) {
+            if self.spool.remove_segment(&path) {
+                self.spool.counters.segments_acked.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+    }
+
+    fn write_pending(&mut self) {
+        if self.pending.is_empty() || self.failed {
+            return;
+        }
+        if self.try_write_pending().is_err() {
+            self.fail();
+        }
+        self.pending.clear();
+    }
+
+    fn try_write_pending(&mut self) -> io::Result<()> {
+        if self.segment.is_none() {
+            let (path, mut file) = self.spool.create_segment()?;
+            let written = file.write_all(&self.header);
+            // Keep the segment even if the header failed, so it is still acked
+            self.segment = Some((path, file, self.header.len() as u64));
+            written?;
+        }
+        let (path, file, len) = self.segment.as_mut().unwrap();
+        let count = (self.pending.len() / POINT_BYTES) as u32;
+        let mut record_header = [0u8; 8];
+        record_header[..4].copy_from_slice(&count.to_le_bytes());
+        record_header[4..].copy_from_slice(&fnv1a32(&self.pending).to_le_bytes());
+        file.write_all(&record_header)?;
+        file.write_all(&self.pending)?;
+        *len += (record_header.len() + self.pending.len()) as u64;
+        let mut points = PointSpan::EMPTY;
+        points.add_record(&self.pending);
+        self.spool.segment_grew(path, *len, points);
+        Ok(())
+    }
+
+    fn fail(&mut self) {
+        self.failed = true;
+        self.spool.counters.write_errors.fetch_add(1, Ordering::Relaxed);
+    }
+}
+
+impl Drop for SpoolWriter {
+    // Runs after the channel's writer has flushed, so every point is acked
+    fn drop(&mut self) {
+        if let Some((path, _, len)) = self.segment.take() {
+            self.spool.segment_sealed(&path, len);
+            self.unacked.push(path);
+        }
+        self.ack();
+    }
+}
+
+/// Reserve `bytes` of disk for `file` without changing its length
+#[cfg(target_os = "linux")]
+fn preallocate(file: &File, bytes: u64) -> io::Result<()> {
+    use std::os::unix::io::AsRawFd;
+    let rc = unsafe { libc::fallocate(file.as_raw_fd(), libc::FALLOC_FL_KEEP_SIZE, 0, bytes as libc::off_t) };
+    if rc != 0 {
+        return Err(io::Error::last_os_error());
+    }
+    Ok(())
+}
+
+#[cfg(not(target_os = "linux"))]
+fn preallocate(_file: &File, _bytes: u64) -> io::Result<()> {
+    Err(io::Error::new(ErrorKind::Unsupported, "preallocation needs Linux"))
+}
+
+fn put_bytes(out: &mut Vec<u8>, bytes: &[u8]) {
+    out.extend_from_slice(&(bytes.len() as u32).to_le_bytes());
+    out.extend_from_slice(bytes);
+}
+
+fn read_u32(reader: &mut impl Read) -> io::Result<u32> {
+    let mut bytes = [0u8; 4];
+    reader.read_exact(&mut bytes)?;
+    Ok(u32::from_le_bytes(bytes))
+}
+
+fn read_string(reader: &mut impl Read) -> io::Result<String> {
+    let len = read_u32(reader)? as usize;
+    if len > MAX_NAME_BYTES {
+        return Err(io::Error::new(ErrorKind::InvalidData, "spool string too long"));
+    }
+    let mut bytes = vec![0u8; len];
+    reader.read_exact(&mut bytes)?;
+    String::from_utf8(bytes).map_err(|e| io::Error::new(ErrorKind::InvalidData, e))
+}
+
+/// Channel name and tags from a segment header
+fn read_header(reader: &mut impl Read) -> io::Result<(String, Vec<(String, String)>)> {
+    let mut magic = [0u8; 8];
+    reader.read_exact(&mut magic)?;
+    if &magic != MAGIC {
+        return Err(io::Error::new(ErrorKind::InvalidData, "not a spool segment"));
+    }
+    let name = read_string(reader)?;
+    let tag_count = read_u32(reader)? as usize;
+    if tag_count > MAX_NAME_BYTES {
+        return Err(io::Error::new(ErrorKind::InvalidData, "too many spool tags"));
+    }
+    let tags = (0..tag_count)
+        .map(|_| Ok((read_string(reader)?, read_string(reader)?)))
+        .collect::<io::Result<_>>()?;
+    Ok((name, tags))
+}
+
+/// Read the next record's points into `points`. Returns false at the end of
+/// the segment or at a torn or corrupt record.
+fn read_record(reader: &mut impl Read, points: &mut Vec<u8>) -> bool {
+    let mut header = [0u8; 8];
+    if reader.read_exact(&mut header).is_err() {
+        return false;
+    }
+    let count = u32::from_le_bytes(header[..4].try_into().unwrap()) as usize;
+    let checksum = u32::from_le_bytes(header[4..].try_into().unwrap());
+    if count == 0 || count > RECORD_POINTS {
+        return false;
+    }
+    points.resize(count * POINT_BYTES, 0);
+    reader.read_exact(points).is_ok() && fnv1a32(points) == checksum
+}
+
+/// Points in a segment up to its first torn or corrupt record
+fn segment_span(path: &Path) -> io::Result<PointSpan> {
+    let mut reader = BufReader::new(File::open(path)?);
+    read_header(&mut reader)?;
+    let mut span = PointSpan::EMPTY;
+    let mut points = Vec::new();
+    while read_record(&mut reader, &mut points) {
+        span.add_record(&points);
+    }
+    Ok(span)
+}
+
+fn fnv1a32(bytes: &[u8]) -> u32 {
+    bytes.iter().fold(0x811c_9dc5, |hash, &byte| (hash ^ byte as u32).wrapping_mul(0x0100_0193))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn temp_spool(name: &str, segment_bytes: u64) -> Arc<Spool> {
+        let dir = std::env::temp_dir().join(name);
+        let _ = fs::remove_dir_all(&dir);
+        let config = SpoolConfig {
+            segment_bytes,
+            ..Default::default()
+        };
+        Spool::open(dir.to_str().unwrap(), config).unwrap()
+    }
+
+    fn segments(spool: &Spool) -> Vec<PathBuf> {
+        let mut paths: Vec<PathBuf> = fs::read_dir(&spool.dir).unwrap().map(|e| e.unwrap().path()).collect();
+        paths.sort();
+        paths
+    }
+
+    #[test]
+    fn test_segment_roundtrip() {
+        let spool = temp_spool("nominal_ffi_spool_roundtrip", DEFAULT_SEGMENT_BYTES);
+        let mut writer = spool.writer("temp", &[("rig", "3")]);
+        for i in 0..5000u64 {
+            assert!(!writer.push(i, i as f64 * 0.5));
+        }
+        writer.seal();
+        // Simulate a crash: the sealed segment is never acked
+        std::mem::forget(writer);
+
+        let paths = segments(&spool);
+        assert_eq!(paths.len(), 1);
+        let mut reader = BufReader::new(File::open(&paths[0]).unwrap());
+        let (name, tags) = read_header(&mut reader).unwrap();
+        assert_eq!(name, "temp");
+        assert_eq!(tags, vec![("rig".to_string(), "3".to_string())]);
+
+        let mut points = Vec::new();
+        let mut total = 0;
+        while read_record(&mut reader, &mut points) {
+            let first = u64::from_le_bytes(points[..8].try_into().unwrap());
+            assert_eq!(first, total as u64);
+            total += points.len() / POINT_BYTES;
+        }
+        assert_eq!(total, 5000);
+        fs::remove_dir_all(&spool.dir).unwrap();
+    }
+
+    #[test]
+    fn test_write_through_without_seal() {
+        let spool = temp_spool("nominal_ffi_spool_write_through", DEFAULT_SEGMENT_BYTES);
+        let mut writer = spool.writer("temp", &[]);
+        for i in 0..3u64 {
+            writer.push(i, 1.0);
+        }
+        assert!(!writer.write_through());
+        // Nothing new to write
+        assert!(!writer.write_through());
+
+        // The points are in the file before any seal, as one short record
+        let paths = segments(&spool);
+        let mut reader = BufReader::new(File::open(&paths[0]).unwrap());
+        read_header(&mut reader).unwrap();
+        let mut points = Vec::new();
+        assert!(read_record(&mut reader, &mut points));
+        assert_eq!(points.len(), 3 * POINT_BYTES);
+        assert!(!read_record(&mut reader, &mut points));
+        std::mem::forget(writer);
+        fs::remove_dir_all(&spool.dir).unwrap();
+    }
+
+    #[test]
+    fn test_torn_record_ends_segment() {
+        let spool = temp_spool("nominal_ffi_spool_torn", DEFAULT_SEGMENT_BYTES);
+        let mut writer = spool.writer("temp", &[]);
+        for i in 0..(RECORD_POINTS as u64 + 10) {
+            writer.push(i, 0.0);
+        }
+        writer.seal();
+        std::mem::forget(writer);
+
+        // Cut the second record short
+        let path = &segments(&spool)[0];
+        let len = fs::metadata(path).unwrap().len();
+        OpenOptions::new().write(true).open(path).unwrap().set_len(len - 3).unwrap();
+
+        let mut reader = BufReader::new(File::open(path).unwrap());
+        read_header(&mut reader).unwrap();
+        let mut points = Vec::new();
+        assert!(read_record(&mut reader, &mut points));
+        assert_eq!(points.len(), RECORD_POINTS * POINT_BYTES);
+        assert!(!read_record(&mut reader, &mut points));
+        fs::remove_dir_all(&spool.dir).unwrap();
+    }
+
+    #[test]
+    fn test_full_segment_and_ack() {
+        // Room for the header and one record
+        let spool = temp_spool("nominal_ffi_spool_ack", 1);
+        let mut writer = spool.writer("temp", &[]);
+        let full = (0..RECORD_POINTS as u64).map(|i| writer.push(i, 0.0)).filter(|&f| f).count();
+        assert_eq!(full, 1);
+        writer.seal();
+        assert_eq!(segments(&spool).len(), 1);
+        writer.ack();
+        assert!(segments(&spool).is_empty());
+        assert_eq!(spool.counters.segments_acked.load(Ordering::Relaxed), 1);
+
+        // Dropping the writer acks whatever it still has open
+        writer.push(1, 1.0);
+        writer.seal();
+        writer.push(2, 2.0);
+        drop(writer);
+        assert!(segments(&spool).is_empty());
+        fs::remove_dir_all(&spool.dir).unwrap();
+    }
+
+    #[test]
+    fn test_segment_cap_evicts_oldest() {
+        let dir = std::env::temp_dir().join("nominal_ffi_spool_cap");
+        let _ = fs::remove_dir_all(&dir);
+        let config = SpoolConfig {
+            segment_bytes: 1,
+            max_segments: 2,
+            preallocate: true,
+            ..Default::default()
+        };
+        let spool = Spool::open(dir.to_str().unwrap(), config).unwrap();
+        let mut writer = spool.writer("temp", &[]);
+        for segment in 0..4u64 {
+            for i in 0..RECORD_POINTS as u64 {
+                writer.push(segment << 32 | i, 0.0);
+            }
+            writer.seal();
+        }
+
+        // Only the two newest sealed segments are left
+        let paths = segments(&spool);
+        assert_eq!(paths.len(), 2);
+        assert!(paths[0].to_str().unwrap().ends_with("-00000002.seg"));
+        assert_eq!(spool.counters.segments_evicted.load(Ordering::Relaxed), 2);
+        // The evicted segments held segment 0's and segment 1's points
+        assert_eq!(spool.counters.points_evicted.load(Ordering::Relaxed), 2 * RECORD_POINTS as u64);
+        assert_eq!(spool.counters.evicted_span(), (0, 1 << 32 | (RECORD_POINTS as u64 - 1)));
+
+        // Sealing released the preallocated tails
+        let on_disk: u64 = paths.iter().map(|p| fs::metadata(p).unwrap().len()).sum();
+        assert_eq!(spool.usage(), (2, on_disk));
+
+        writer.ack();
+        assert_eq!(spool.usage(), (0, 0));
+        assert_eq!(spool.counters.segments_acked.load(Ordering::Relaxed), 2);
+        fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_evicted_leftover_span() {
+        let spool = temp_spool("nominal_ffi_spool_evict_leftover", DEFAULT_SEGMENT_BYTES);
+        let mut writer = spool.writer("temp", &[]);
+        for i in 100..200u64 {
+            writer.push(i, 0.0);
+        }
+        writer.seal();
+        std::mem::forget(writer);
+
+        // The next run caps the spool at one segment, so its first segment
+        // evicts the leftover
+        let config = SpoolConfig {
+            max_segments: 1,
+            ..Default::default()
+        };
+        let reopened = Spool::open(spool.dir.to_str().unwrap(), config).unwrap();
+        assert_eq!(reopened.counters.evicted_span(), (0, 0));
+        let mut writer = reopened.writer("temp", &[]);
+        writer.push(1_000, 0.0);
+        writer.write_through();
+        assert_eq!(reopened.counters.points_evicted.load(Ordering::Relaxed), 100);
+        assert_eq!(reopened.counters.evicted_span(), (100, 199));
+        drop(writer);
+        fs::remove_dir_all(&spool.dir).unwrap();
+    }
+}
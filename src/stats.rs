@@ -0,0 +1,302 @@
+//! Counters and latency histograms behind `nominal_get_channel_stats` and
+//! `nominal_get_stream_stats`.
+//!
+//! Each channel records into its own `ChannelStats` with relaxed atomics, so
+//! producers on different channels never share a cache line. Stream totals are
+//! merged from the channels when they are read. When a channel is closed, its
+//! stats are folded into the stream so the totals don't go backwards.
+//!
+//! Histograms are log-linear in the style of HdrHistogram. Each power of two
+//! is split into 8 linear buckets, so a reported percentile is within 12.5% of
+//! the true value.
+
+use once_cell::sync::Lazy;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::time::Instant;
+
+const SUB_BUCKET_BITS: u32 = 3;
+const SUB_BUCKETS: usize = 1 << SUB_BUCKET_BITS;
+// Bucket groups; the last one covers about 2.4 hours, and longer values are
+// counted there
+const GROUPS: usize = 41;
+const BUCKETS: usize = GROUPS * SUB_BUCKETS;
+
+static EPOCH: Lazy<Instant> = Lazy::new(Instant::now);
+
+/// Nanoseconds from a process-wide epoch to `instant`, never 0
+#[inline]
+pub fn nanos_since_epoch(instant: Instant) -> u64 {
+    instant.saturating_duration_since(*EPOCH).as_nanos() as u64 + 1
+}
+
+#[inline]
+fn bucket_index(ns: u64) -> usize {
+    if ns < SUB_BUCKETS as u64 {
+        return ns as usize;
+    }
+    let exponent = 63 - ns.leading_zeros();
+    let sub = (ns >> (exponent - SUB_BUCKET_BITS)) as usize & (SUB_BUCKETS - 1);
+    let group = (exponent - SUB_BUCKET_BITS + 1) as usize;
+    (group * SUB_BUCKETS + sub).min(BUCKETS - 1)
+}
+
+/// Largest value that lands in bucket `index`
+fn bucket_value(index: usize) -> u64 {
+    if index < SUB_BUCKETS {
+        return index as u64;
+    }
+    let exponent = (index / SUB_BUCKETS) as u32 + SUB_BUCKET_BITS - 1;
+    let width = 1u64 << (exponent - SUB_BUCKET_BITS);
+    (1u64 << exponent) + (index % SUB_BUCKETS) as u64 * width + width - 1
+}
+
+/// Lock-free latency histogram in nanoseconds
+pub struct Histogram {
+    buckets: Box<[AtomicU64]>,
+    sum_ns: AtomicU64,
+    max_ns: AtomicU64,
+}
+
+impl Default for Histogram {
+    fn default() -> Self {
+        Self {
+            buckets: (0..BUCKETS).map(|_| AtomicU64::new(0)).collect(),
+            sum_ns: AtomicU64::new(0),
+            max_ns: AtomicU64::new(0),
+        }
+    }
+}
+
+impl Histogram {
+    #[inline]
+    pub fn record(&self, ns: u64) {
+        self.buckets[bucket_index(ns)].fetch_add(1, Ordering::Relaxed);
+        self.sum_ns.fetch_add(ns, Ordering::Relaxed);
+        if ns > self.max_ns.load(Ordering::Relaxed) {
+            self.max_ns.fetch_max(ns, Ordering::Relaxed);
+        }
+    }
+
+    /// Add `other`'s samples to this histogram
+    pub fn absorb(&self, other: &Histogram) {
+        for (bucket, theirs) in self.buckets.iter().zip(other.buckets.iter()) {
+            let n = theirs.load(Ordering::Relaxed);
+            if n > 0 {
+                bucket.fetch_add(n, Ordering::Relaxed);
+            }
+        }
+        self.sum_ns.fetch_add(other.sum_ns.load(Ordering::Relaxed), Ordering::Relaxed);
+        self.max_ns.fetch_max(other.max_ns.load(Ordering::Relaxed), Ordering::Relaxed);
+    }
+
+    pub fn summary(&self) -> NominalLatencyStats {
+        let counts: Vec<u64> = self.buckets.iter().map(|b| b.load(Ordering::Relaxed)).collect();
+        let count: u64 = counts.iter().sum();
+        if count == 0 {
+            return NominalLatencyStats::default();
+        }
+        let max_ns = self.max_ns.load(Ordering::Relaxed);
+        let percentile = |q: f64| {
+            let rank = ((count as f64 * q).ceil() as u64).max(1);
+            let mut seen = 0;
+            for (index, &n) in counts.iter().enumerate() {
+                seen += n;
+                if seen >= rank {
+                    return bucket_value(index).min(max_ns);
+                }
+            }
+            max_ns
+        };
+        NominalLatencyStats {
+            count,
+            mean_ns: self.sum_ns.load(Ordering::Relaxed) / count,
+            p50_ns: percentile(0.50),
+            p90_ns: percentile(0.90),
+            p99_ns: percentile(0.99),
+            max_ns,
+        }
+    }
+}
+
+/// Summary of one latency histogram
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct NominalLatencyStats {
+    pub count: u64,
+    pub mean_ns: u64,
+    pub p50_ns: u64,
+    pub p90_ns: u64,
+    pub p99_ns: u64,
+    pub max_ns: u64,
+}
+
+/// Live counters for one channel, or the retired total of a stream's channels
+#[derive(Default)]
+pub(crate) struct ChannelStats {
+    // Points held for the stream (in the writer or the ring), net of anything
+    // the backpressure policy dropped or spilled
+    pub points_accepted: AtomicU64,
+    // Duration of each push call
+    pub push_latency: Histogram,
+    // Age of the oldest point in the async ring each time it is drained
+    pub queue_latency: Histogram,
+    // Time to hand a channel's buffer to the stream on flush
+    pub flush_latency: Histogram,
+    // Points dropped by compression, never part of `points_accepted`
+    pub points_suppressed: AtomicU64,
+}
+
+impl ChannelStats {
+    pub fn absorb(&self, other: &ChannelStats) {
+        self.points_accepted
+            .fetch_add(other.points_accepted.load(Ordering::Relaxed), Ordering::Relaxed);
+        self.push_latency.absorb(&other.push_latency);
+        self.queue_latency.absorb(&other.queue_latency);
+        self.flush_latency.absorb(&other.flush_latency);
+        self.points_suppressed
+            .fetch_add(other.points_suppressed.load(Ordering::Relaxed), Ordering::Relaxed);
+    }
+}
+
+/// Bytes of raw point data (timestamp and value) represented by `points`
+pub fn point_bytes(points: u64) -> u64 {
+    points * std::mem::size_of::<(u64, f64)>() as u64
+}
+
+/// Statistics for `nominal_get_channel_stats`
+///
+/// Same versioning as the options structs: the caller sets `struct_size`, and
+/// only that many bytes are written.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct NominalChannelStats {
+    pub struct_size: u64,
+    pub points_accepted: u64,
+    pub bytes_accepted: u64,
+    /// Points waiting in the async ring (0 for synchronous channels)
+    pub queued_points: u64,
+    pub push_latency: NominalLatencyStats,
+    pub queue_latency: NominalLatencyStats,
+    pub flush_latency: NominalLatencyStats,
+    /// Points dropped by the channel's compression
+    pub points_suppressed: u64,
+}
+
+/// Statistics for `nominal_get_stream_stats`, totalled over every channel the
+/// stream has had
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct NominalStreamStats {
+    pub struct_size: u64,
+    pub channels_open: u64,
+    pub points_accepted: u64,
+    pub bytes_accepted: u64,
+    pub queued_points: u64,
+    pub dropped_points: u64,
+    pub spilled_points: u64,
+    pub block_timeouts: u64,
+    pub push_latency: NominalLatencyStats,
+    pub queue_latency: NominalLatencyStats,
+    pub flush_latency: NominalLatencyStats,
+    /// Spool segments deleted once the stream had their points
+    pub spool_segments_acked: u64,
+    /// Leftover spool segments still to replay
+    pub spool_segments_pending: u64,
+    pub spool_replayed_points: u64,
+    pub spool_errors: u64,
+    /// Spool segments on disk, including leftovers not yet replayed
+    pub spool_segments: u64,
+    /// Disk taken by the spool, counting open preallocated segments in full
+    pub spool_bytes: u64,
+    /// Spool segments deleted unsent to stay under `spool_max_segments`
+    pub spool_segments_evicted: u64,
+    pub points_suppressed: u64,
+    /// Points in the evicted spool segments, and the earliest and latest
+    /// timestamp among them; both 0 until something is evicted
+    pub spool_points_evicted: u64,
+    pub spool_evicted_first_ns: u64,
+    pub spool_evicted_last_ns: u64,
+}
+
+/// Write the first `struct_size` bytes of `value` to a caller's struct,
+/// where `struct_size` is the leading u64 the caller set
+///
+/// # Safety
+/// `out` must point to at least `struct_size` writable bytes.
+pub unsafe fn write_versioned<T: Copy>(out: *mut T, value: &T) -> Result<(), String> {
+    let struct_size = std::ptr::read_unaligned(out as *const u64) as usize;
+    if struct_size < std::mem::size_of::<u64>() {
+        return Err(format!("Invalid stats struct_size: {}", struct_size));
+    }
+    // Leave the caller's struct_size in place
+    let skip = std::mem::size_of::<u64>();
+    let len = struct_size.min(std::mem::size_of::<T>());
+    std::ptr::copy_nonoverlapping(
+        (value as *const T as *const u8).add(skip),
+        (out as *mut u8).add(skip),
+        len - skip,
+    );
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_buckets_are_contiguous() {
+        let mut previous = 0;
+        for ns in 1..100_000u64 {
+            let index = bucket_index(ns);
+            assert!(index == previous || index == previous + 1);
+            assert!(ns <= bucket_value(index));
+            previous = index;
+        }
+        assert_eq!(bucket_index(u64::MAX), BUCKETS - 1);
+    }
+
+    #[test]
+    fn test_percentiles_within_resolution() {
+        let histogram = Histogram::default();
+        for ns in 1..=1000u64 {
+            histogram.record(ns * 1000);
+        }
+        let summary = histogram.summary();
+        assert_eq!(summary.count, 1000);
+        assert_eq!(summary.max_ns, 1_000_000);
+        assert_eq!(summary.mean_ns, 500_500);
+        for (reported, exact) in [(summary.p50_ns, 500_000.0), (summary.p99_ns, 990_000.0)] {
+            let error = (reported as f64 - exact).abs() / exact;
+            assert!(error <= 0.125, "{} vs {}", reported, exact);
+        }
+    }
+
+    #[test]
+    fn test_absorb() {
+        let a = Histogram::default();
+        let b = Histogram::default();
+        a.record(10);
+        b.record(20);
+        b.record(30);
+        a.absorb(&b);
+        let summary = a.summary();
+        assert_eq!(summary.count, 3);
+        assert_eq!(summary.mean_ns, 20);
+        assert_eq!(summary.max_ns, 30);
+    }
+
+    #[test]
+    fn test_write_versioned_short_struct() {
+        // A caller that only knows about the first three fields
+        let mut fields: [u64; 4] = [24, 0, 0, 99];
+        let stats = NominalChannelStats {
+            struct_size: 0,
+            points_accepted: 5,
+            bytes_accepted: 80,
+            queued_points: 1,
+            ..Default::default()
+        };
+        unsafe { write_versioned(fields.as_mut_ptr() as *mut NominalChannelStats, &stats) }.unwrap();
+        assert_eq!(fields, [24, 5, 80, 99]);
+    }
+}
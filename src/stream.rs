@@ -0,0 +1,358 @@
+//! Per-handle stream state and the options accepted by `nominal_init_ex`.
+
+use crate::spool::{Spool, SpoolConfig};
+use crate::stats::ChannelStats;
+use crate::tags::{TagSet, TagTable};
+use nominal_streaming::stream::{NominalDatasetStream, NominalDatasetStreamBuilder, NominalStreamOpts};
+use once_cell::sync::OnceCell;
+use parking_lot::RwLock;
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+use std::time::Duration;
+
+/// Ring size used for channels on a stream with a backpressure policy, in points
+pub const DEFAULT_QUEUE_CAPACITY: usize = 1 << 16;
+
+/// Wait used by `Backpressure::Block` when no timeout is given
+pub const DEFAULT_BLOCK_TIMEOUT: Duration = Duration::from_millis(100);
+
+/// What a push does when a channel's queue has no room for its batch
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum Backpressure {
+    /// Channels push synchronously unless `nominal_enable_async` is called, and
+    /// a full async queue rejects the batch with `ERROR_QUEUE_FULL`
+    None,
+    /// Wait for the drain task to make room, up to the block timeout, then
+    /// reject the batch with `ERROR_QUEUE_FULL`
+    Block,
+    /// Discard the oldest queued points to make room for the new batch
+    DropOldest,
+    /// Queue what fits and discard the rest of the new batch
+    DropNewest,
+    /// Queue what fits and write the rest to the stream's spill file
+    Spill,
+}
+
+impl Backpressure {
+    fn from_code(code: u64) -> Result<Self, String> {
+        match code {
+            0 => Ok(Backpressure::None),
+            1 => Ok(Backpressure::Block),
+            2 => Ok(Backpressure::DropOldest),
+            3 => Ok(Backpressure::DropNewest),
+            4 => Ok(Backpressure::Spill),
+            _ => Err(format!("Invalid backpressure policy: {}", code)),
+        }
+    }
+}
+
+/// Options for `nominal_init_ex`
+///
+/// Every field is 8 bytes wide so the layout is identical on every platform,
+/// including 32-bit LabVIEW clusters. `struct_size` must hold the size in
+/// bytes of the struct the caller was built against; fields past that size
+/// keep their defaults, so callers built against an older, shorter version
+/// keep working. A 0 in any other field selects the default.
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct NominalStreamOptions {
+    pub struct_size: u64,
+    /// 0 none, 1 block, 2 drop oldest, 3 drop newest, 4 spill to file
+    pub backpressure_policy: u64,
+    /// Ring size per channel in points (default 65536)
+    pub queue_capacity: u64,
+    /// How long `Block` waits for room (default 100 ms)
+    pub block_timeout_ms: u64,
+    /// Most points sent in one request (default: nominal-streaming's)
+    pub max_points_per_request: u64,
+    /// Longest a partly filled request waits before it is sent
+    pub max_linger_ms: u64,
+    /// Requests built but not yet sent before pushes start to wait
+    pub max_buffered_requests: u64,
+    /// Requests sent concurrently
+    pub request_concurrency: u64,
+    /// Spool segment size in bytes (default 64 MiB), see `nominal_init_spool`
+    pub spool_segment_bytes: u64,
+    /// Rate at which leftover spool segments are replayed (default 100000 points/s)
+    pub spool_replay_rate: u64,
+    /// Most spool segments kept on disk; the oldest are evicted past this (default: no cap)
+    pub spool_max_segments: u64,
+    /// 1 to preallocate each spool segment's full size with `fallocate` (Linux only)
+    pub spool_preallocate: u64,
+}
+
+impl NominalStreamOptions {
+    /// Read options from a caller-provided struct of any supported version
+    ///
+    /// # Safety
+    /// `options` must point to at least `struct_size` readable bytes.
+    pub unsafe fn read(options: *const NominalStreamOptions) -> Result<Self, String> {
+        let struct_size = std::ptr::read_unaligned(options as *const u64) as usize;
+        if struct_size < std::mem::size_of::<u64>() {
+            return Err(format!("Invalid options struct_size: {}", struct_size));
+        }
+        let mut parsed = NominalStreamOptions::default();
+        let len = struct_size.min(std::mem::size_of::<NominalStreamOptions>());
+        std::ptr::copy_nonoverlapping(
+            options as *const u8,
+            &mut parsed as *mut NominalStreamOptions as *mut u8,
+            len,
+        );
+        Ok(parsed)
+    }
+}
+
+/// Overrides for the stream builder's batching; `None` keeps its default
+#[derive(Clone, Debug, Default, PartialEq, Eq)]
+pub struct Batching {
+    pub max_points_per_request: Option<usize>,
+    pub max_linger: Option<Duration>,
+    pub max_buffered_requests: Option<usize>,
+    pub request_concurrency: Option<usize>,
+}
+
+impl Batching {
+    /// Builder options with these overrides applied
+    pub fn stream_opts(&self) -> NominalStreamOpts {
+        // Set only the fields we override, so fields added upstream keep
+        // their defaults
+        let mut opts = NominalStreamOpts::default();
+        if let Some(points) = self.max_points_per_request {
+            opts.max_points_per_record = points;
+        }
+        if let Some(linger) = self.max_linger {
+            opts.max_request_delay = linger;
+        }
+        if let Some(requests) = self.max_buffered_requests {
+            opts.max_buffered_requests = requests;
+        }
+        if let Some(tasks) = self.request_concurrency {
+            opts.request_dispatcher_tasks = tasks;
+        }
+        opts
+    }
+}
+
+/// Resolved stream configuration
+#[derive(Clone, Debug)]
+pub struct StreamConfig {
+    pub backpressure: Backpressure,
+    pub queue_capacity: usize,
+    pub block_timeout: Duration,
+    pub batching: Batching,
+    pub spool: SpoolConfig,
+}
+
+impl Default for StreamConfig {
+    fn default() -> Self {
+        Self {
+            backpressure: Backpressure::None,
+            queue_capacity: DEFAULT_QUEUE_CAPACITY,
+            block_timeout: DEFAULT_BLOCK_TIMEOUT,
+            batching: Batching::default(),
+            spool: SpoolConfig::default(),
+        }
+    }
+}
+
+impl StreamConfig {
+    pub fn from_options(options: &NominalStreamOptions) -> Result<Self, String> {
+        let defaults = StreamConfig::default();
+        Ok(Self {
+            backpressure: Backpressure::from_code(options.backpressure_policy)?,
+            queue_capacity: match options.queue_capacity {
+                0 => defaults.queue_capacity,
+                n => n as usize,
+            },
+            block_timeout: match options.block_timeout_ms {
+                0 => defaults.block_timeout,
+                ms => Duration::from_millis(ms),
+            },
+            batching: Batching {
+                max_points_per_request: nonzero(options.max_points_per_request),
+                max_linger: (options.max_linger_ms != 0).then(|| Duration::from_millis(options.max_linger_ms)),
+                max_buffered_requests: nonzero(options.max_buffered_requests),
+                request_concurrency: nonzero(options.request_concurrency),
+            },
+            spool: SpoolConfig {
+                segment_bytes: match options.spool_segment_bytes {
+                    0 => defaults.spool.segment_bytes,
+                    n => n,
+                },
+                replay_rate: match options.spool_replay_rate {
+                    0 => defaults.spool.replay_rate,
+                    n => n,
+                },
+                max_segments: options.spool_max_segments,
+                preallocate: match options.spool_preallocate {
+                    0 => false,
+                    1 => true,
+                    n => return Err(format!("Invalid spool_preallocate: {}", n)),
+                },
+            },
+        })
+    }
+}
+
+fn nonzero(value: u64) -> Option<usize> {
+    (value != 0).then_some(value as usize)
+}
+
+/// Points the backpressure policy discarded or diverted
+#[derive(Default)]
+pub struct BackpressureCounters {
+    pub dropped_points: AtomicU64,
+    pub spilled_points: AtomicU64,
+    pub block_timeouts: AtomicU64,
+}
+
+/// Snapshot of `BackpressureCounters` for `nominal_get_backpressure_counters`
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct NominalBackpressureCounters {
+    pub dropped_points: u64,
+    pub spilled_points: u64,
+    pub block_timeouts: u64,
+}
+
+impl BackpressureCounters {
+    pub fn snapshot(&self) -> NominalBackpressureCounters {
+        NominalBackpressureCounters {
+            dropped_points: self.dropped_points.load(Ordering::Relaxed),
+            spilled_points: self.spilled_points.load(Ordering::Relaxed),
+            block_timeouts: self.block_timeouts.load(Ordering::Relaxed),
+        }
+    }
+}
+
+/// A channel's interned name and its tags merged with the stream's defaults
+pub(crate) type ChannelKey = (u32, TagSet);
+
+pub(crate) struct StreamState {
+    pub(crate) stream: Arc<NominalDatasetStream>,
+    pub(crate) config: StreamConfig,
+    pub(crate) counters: BackpressureCounters,
+    // Stats of channels already closed, see `stats`
+    pub(crate) retired_stats: ChannelStats,
+    // Local disk spool, for streams opened with nominal_init_spool
+    pub(crate) spool: Option<Arc<Spool>>,
+    // Tag keys and values of this stream's channels, see `tags`
+    pub(crate) tags: TagTable,
+    // Merged into the tags of every channel created from now on
+    pub(crate) default_tags: RwLock<TagSet>,
+    // Handle of the first live channel for each name and tag set, see
+    // nominal_get_or_create_channel. Entries for closed channels are replaced
+    // when the key is next used.
+    pub(crate) channel_index: RwLock<HashMap<ChannelKey, u64>>,
+    // Where `Backpressure::Spill` writes overflow, opened on first use
+    spill_path: Option<String>,
+    spill_stream: OnceCell<Arc<NominalDatasetStream>>,
+}
+
+impl StreamState {
+    pub(crate) fn new(
+        stream: NominalDatasetStream,
+        config: StreamConfig,
+        fallback_path: Option<&str>,
+        spool: Option<Arc<Spool>>,
+    ) -> Self {
+        Self {
+            stream: Arc::new(stream),
+            config,
+            counters: BackpressureCounters::default(),
+            retired_stats: ChannelStats::default(),
+            spool,
+            tags: TagTable::default(),
+            default_tags: RwLock::new(TagSet::from([])),
+            channel_index: RwLock::new(HashMap::new()),
+            spill_path: fallback_path.map(spill_path_for),
+            spill_stream: OnceCell::new(),
+        }
+    }
+
+    /// Spill stream for `Backpressure::Spill`, opened on first use
+    pub(crate) fn spill_stream(&self) -> Result<&Arc<NominalDatasetStream>, String> {
+        let path = self
+            .spill_path
+            .as_ref()
+            .ok_or_else(|| "Spill policy requires a fallback file path".to_string())?;
+        Ok(self.spill_stream.get_or_init(|| {
+            let _guard = crate::RUNTIME.enter();
+            Arc::new(NominalDatasetStreamBuilder::new().stream_to_file(path).build())
+        }))
+    }
+}
+
+impl Drop for StreamState {
+    fn drop(&mut self) {
+        // Stop replay before the stream is dropped, so the stream closes now
+        if let Some(spool) = &self.spool {
+            spool.close();
+        }
+    }
+}
+
+/// Spill file next to the fallback file: `run.avro` -> `run.spill.avro`
+fn spill_path_for(fallback_path: &str) -> String {
+    match fallback_path.strip_suffix(".avro") {
+        Some(stem) => format!("{}.spill.avro", stem),
+        None => format!("{}.spill", fallback_path),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_options_layout() {
+        assert_eq!(std::mem::size_of::<NominalStreamOptions>(), 96);
+    }
+
+    #[test]
+    fn test_read_short_options_keeps_defaults() {
+        // A caller that only knows about the first two fields
+        let fields: [u64; 2] = [16, 2];
+        let options = unsafe { NominalStreamOptions::read(fields.as_ptr() as *const _) }.unwrap();
+        let config = StreamConfig::from_options(&options).unwrap();
+        assert_eq!(config.backpressure, Backpressure::DropOldest);
+        assert_eq!(config.queue_capacity, DEFAULT_QUEUE_CAPACITY);
+        assert_eq!(config.block_timeout, DEFAULT_BLOCK_TIMEOUT);
+        assert_eq!(config.batching, Batching::default());
+    }
+
+    #[test]
+    fn test_batching_overrides() {
+        let options = NominalStreamOptions {
+            struct_size: 64,
+            max_points_per_request: 1000,
+            max_linger_ms: 5,
+            ..Default::default()
+        };
+        let opts = StreamConfig::from_options(&options).unwrap().batching.stream_opts();
+        let defaults = NominalStreamOpts::default();
+        assert_eq!(opts.max_points_per_record, 1000);
+        assert_eq!(opts.max_request_delay, Duration::from_millis(5));
+        assert_eq!(opts.max_buffered_requests, defaults.max_buffered_requests);
+        assert_eq!(opts.request_dispatcher_tasks, defaults.request_dispatcher_tasks);
+    }
+
+    #[test]
+    fn test_invalid_options() {
+        let fields: [u64; 1] = [0];
+        assert!(unsafe { NominalStreamOptions::read(fields.as_ptr() as *const _) }.is_err());
+        let options = NominalStreamOptions {
+            struct_size: 32,
+            backpressure_policy: 9,
+            ..Default::default()
+        };
+        assert!(StreamConfig::from_options(&options).is_err());
+    }
+
+    #[test]
+    fn test_spill_path_for() {
+        assert_eq!(spill_path_for("/data/run.avro"), "/data/run.spill.avro");
+        assert_eq!(spill_path_for("/data/run"), "/data/run.spill");
+    }
+}
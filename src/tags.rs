@@ -0,0 +1,165 @@
+//! Per-stream tag interning.
+//!
+//! Channels on a rig share most of their tags (rig id, test id, operator), so
+//! each stream keeps one table of the tag keys and values its channels use.
+//! A channel's tags become a `TagSet`: (key id, value id) pairs into that
+//! table, sorted by key, which compare and hash as plain integers. Each
+//! distinct string is stored once however many channels use it, and each
+//! distinct tags CSV is parsed once per stream.
+//!
+//! A stream can also have default tags, which are merged into every channel
+//! created on it; a channel's own value for a key takes precedence.
+//!
+//! Tables only grow. Their size is bounded by the distinct strings and CSVs
+//! a stream's channels use, not by the number of channels.
+
+use crate::parse_tags_csv;
+use parking_lot::RwLock;
+use std::collections::{BTreeMap, HashMap};
+use std::sync::Arc;
+
+/// Sorted (key id, value id) pairs into a stream's `TagTable`
+pub(crate) type TagSet = Arc<[(u32, u32)]>;
+
+#[derive(Default)]
+pub(crate) struct TagTable {
+    inner: RwLock<Inner>,
+}
+
+#[derive(Default)]
+struct Inner {
+    ids: HashMap<Arc<str>, u32>,
+    strings: Vec<Arc<str>>,
+    // Tag sets of CSVs already seen
+    csv: HashMap<Box<str>, TagSet>,
+}
+
+impl Inner {
+    fn id(&mut self, s: &str) -> u32 {
+        if let Some(&id) = self.ids.get(s) {
+            return id;
+        }
+        let id = self.strings.len() as u32;
+        let s: Arc<str> = Arc::from(s);
+        self.strings.push(Arc::clone(&s));
+        self.ids.insert(s, id);
+        id
+    }
+
+    fn tag_set<'a>(&mut self, tags: impl IntoIterator<Item = (&'a str, &'a str)>) -> TagSet {
+        // A repeated key keeps its last value, as in a descriptor's tag map
+        let pairs: BTreeMap<u32, u32> = tags
+            .into_iter()
+            .map(|(key, value)| (self.id(key), self.id(value)))
+            .collect();
+        pairs.into_iter().collect()
+    }
+}
+
+impl TagTable {
+    /// Id of one string, for channel names
+    pub(crate) fn intern_str(&self, s: &str) -> u32 {
+        if let Some(&id) = self.inner.read().ids.get(s) {
+            return id;
+        }
+        self.inner.write().id(s)
+    }
+
+    /// Tag set for key/value pairs
+    pub(crate) fn intern<'a>(&self, tags: impl IntoIterator<Item = (&'a str, &'a str)>) -> TagSet {
+        self.inner.write().tag_set(tags)
+    }
+
+    /// Tag set for a `key=value,...` CSV, parsed the first time the stream sees it
+    pub(crate) fn intern_csv(&self, tags_csv: &str) -> TagSet {
+        if let Some(tags) = self.inner.read().csv.get(tags_csv) {
+            return Arc::clone(tags);
+        }
+        let mut inner = self.inner.write();
+        let tags = inner.tag_set(parse_tags_csv(tags_csv));
+        inner.csv.insert(Box::from(tags_csv), Arc::clone(&tags));
+        tags
+    }
+
+    /// The strings behind a tag set, in key order
+    pub(crate) fn resolve(&self, tags: &TagSet) -> Vec<(Arc<str>, Arc<str>)> {
+        let inner = self.inner.read();
+        tags.iter()
+            .map(|&(key, value)| {
+                (
+                    Arc::clone(&inner.strings[key as usize]),
+                    Arc::clone(&inner.strings[value as usize]),
+                )
+            })
+            .collect()
+    }
+
+    /// The string behind an id
+    #[cfg(test)]
+    pub(crate) fn string(&self, id: u32) -> Arc<str> {
+        Arc::clone(&self.inner.read().strings[id as usize])
+    }
+
+    /// Distinct strings stored
+    #[cfg(test)]
+    fn len(&self) -> usize {
+        self.inner.read().strings.len()
+    }
+}
+
+/// `defaults` with `tags` laid over them; both are sorted by key id
+pub(crate) fn merge(defaults: &TagSet, tags: &TagSet) -> TagSet {
+    if defaults.is_empty() {
+        return Arc::clone(tags);
+    }
+    let mut merged: BTreeMap<u32, u32> = defaults.iter().copied().collect();
+    merged.extend(tags.iter().copied());
+    merged.into_iter().collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_shared_strings_stored_once() {
+        let table = TagTable::default();
+        let a = table.intern([("rig", "7"), ("test", "burn_in"), ("unit", "degC")]);
+        let b = table.intern([("unit", "psi"), ("rig", "7"), ("test", "burn_in")]);
+        assert_eq!(table.len(), 7);
+        // Same keys, so the same key ids in the same (sorted) order
+        let keys = |t: &TagSet| t.iter().map(|&(k, _)| k).collect::<Vec<_>>();
+        assert_eq!(keys(&a), keys(&b));
+        assert_ne!(a, b);
+        assert_eq!(table.intern([("test", "burn_in"), ("unit", "degC"), ("rig", "7")]), a);
+    }
+
+    #[test]
+    fn test_last_value_wins_and_resolve() {
+        let table = TagTable::default();
+        let tags = table.intern([("rig", "1"), ("rig", "2")]);
+        let resolved = table.resolve(&tags);
+        assert_eq!(resolved.len(), 1);
+        assert_eq!((&*resolved[0].0, &*resolved[0].1), ("rig", "2"));
+    }
+
+    #[test]
+    fn test_merge_overrides_defaults() {
+        let table = TagTable::default();
+        let defaults = table.intern([("rig", "7"), ("test", "burn_in")]);
+        let tags = table.intern([("test", "soak"), ("unit", "degC")]);
+        let merged = table.intern([("rig", "7"), ("test", "soak"), ("unit", "degC")]);
+        assert_eq!(merge(&defaults, &tags), merged);
+        assert_eq!(merge(&table.intern([]), &tags), tags);
+    }
+
+    #[test]
+    fn test_csv_cached() {
+        let table = TagTable::default();
+        let a = table.intern_csv("rig=7,test=burn_in");
+        let b = table.intern_csv("rig=7,test=burn_in");
+        assert!(Arc::ptr_eq(&a, &b));
+        assert_eq!(table.intern([("test", "burn_in"), ("rig", "7")]), a);
+        assert!(table.intern_csv("").is_empty());
+    }
+}
@@ -0,0 +1,506 @@
+//! Bulk re-upload of fallback AVRO files for `nominal_upload_fallback_files`.
+//!
+//! Files are decoded record by record and streamed to Core through the same
+//! writers live data uses, `parallelism` files at a time on the runtime's
+//! blocking pool. Progress is kept in a `<file>.progress` checkpoint next to
+//! each file. After every million points the upload stream is closed, which
+//! sends what it holds or writes it to a `<file>.retry-<record>.avro`
+//! fallback, and only then does the checkpoint advance. An interrupted upload
+//! resumes from the last checkpoint, and later runs skip finished files.
+//!
+//! A chunk whose stream wrote anything to its retry file, for example
+//! because the network was down, counts as retried rather than uploaded:
+//! nominal-streaming doesn't say which of its points made it. The retry file
+//! is itself a fallback file to upload on a later run.
+
+use crate::channel::{descriptor, WriterState};
+use apache_avro::types::Value;
+use apache_avro::Reader;
+use nominal_streaming::stream::NominalDatasetStream;
+use parking_lot::Mutex;
+use std::collections::{HashMap, VecDeque};
+use std::ffi::OsString;
+use std::fs::{self, File};
+use std::io::{self, BufReader, ErrorKind};
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::Arc;
+
+/// Points sent between checkpoints
+const CHECKPOINT_POINTS: u64 = 1_000_000;
+
+/// Outcome of `nominal_upload_fallback_files`
+#[repr(C)]
+#[derive(Clone, Copy, Debug, Default)]
+pub struct NominalUploadReport {
+    pub files_matched: u64,
+    pub files_uploaded: u64,
+    /// Already complete from an earlier run
+    pub files_skipped: u64,
+    pub files_failed: u64,
+    pub records_uploaded: u64,
+    pub points_uploaded: u64,
+    /// Records that aren't a channel of timestamped doubles, which are left out
+    pub records_unsupported: u64,
+    /// Files, records and points that went to a retry file instead
+    pub files_retried: u64,
+    pub records_retried: u64,
+    pub points_retried: u64,
+}
+
+#[derive(Default)]
+struct Counters {
+    files_uploaded: AtomicU64,
+    files_skipped: AtomicU64,
+    files_failed: AtomicU64,
+    records_uploaded: AtomicU64,
+    points_uploaded: AtomicU64,
+    records_unsupported: AtomicU64,
+    files_retried: AtomicU64,
+    records_retried: AtomicU64,
+    points_retried: AtomicU64,
+}
+
+/// How a file's upload ended
+enum Outcome {
+    Uploaded,
+    // Some of it went to retry files
+    Retried,
+    // Complete from an earlier run
+    Skipped,
+}
+
+/// Opens an upload stream that falls back to the given file
+pub(crate) type StreamFactory = dyn Fn(&Path) -> Option<NominalDatasetStream> + Send + Sync;
+
+/// Upload `files` with `parallelism` workers. Returns the report and the
+/// first error, if any file failed.
+pub(crate) async fn upload(
+    files: Vec<PathBuf>,
+    parallelism: usize,
+    new_stream: Arc<StreamFactory>,
+) -> (NominalUploadReport, Option<String>) {
+    let files_matched = files.len() as u64;
+    let queue = Arc::new(Mutex::new(VecDeque::from(files)));
+    let counters = Arc::new(Counters::default());
+    let first_error = Arc::new(Mutex::new(None));
+
+    let workers: Vec<_> = (0..parallelism.max(1))
+        .map(|_| {
+            let queue = Arc::clone(&queue);
+            let counters = Arc::clone(&counters);
+            let first_error = Arc::clone(&first_error);
+            let new_stream = Arc::clone(&new_stream);
+            tokio::task::spawn_blocking(move || loop {
+                let Some(path) = queue.lock().pop_front() else { break };
+                match upload_file(&path, &*new_stream, &counters) {
+                    Ok(Outcome::Uploaded) => counters.files_uploaded.fetch_add(1, Ordering::Relaxed),
+                    Ok(Outcome::Retried) => counters.files_retried.fetch_add(1, Ordering::Relaxed),
+                    Ok(Outcome::Skipped) => counters.files_skipped.fetch_add(1, Ordering::Relaxed),
+                    Err(e) => {
+                        first_error.lock().get_or_insert(e);
+                        counters.files_failed.fetch_add(1, Ordering::Relaxed)
+                    }
+                };
+            })
+        })
+        .collect();
+    for worker in workers {
+        let _ = worker.await;
+    }
+
+    let report = NominalUploadReport {
+        files_matched,
+        files_uploaded: counters.files_uploaded.load(Ordering::Relaxed),
+        files_skipped: counters.files_skipped.load(Ordering::Relaxed),
+        files_failed: counters.files_failed.load(Ordering::Relaxed),
+        records_uploaded: counters.records_uploaded.load(Ordering::Relaxed),
+        points_uploaded: counters.points_uploaded.load(Ordering::Relaxed),
+        records_unsupported: counters.records_unsupported.load(Ordering::Relaxed),
+        files_retried: counters.files_retried.load(Ordering::Relaxed),
+        records_retried: counters.records_retried.load(Ordering::Relaxed),
+        points_retried: counters.points_retried.load(Ordering::Relaxed),
+    };
+    let error = first_error.lock().take();
+    (report, error)
+}
+
+/// Upload one file from its checkpoint
+fn upload_file(path: &Path, new_stream: &StreamFactory, counters: &Counters) -> Result<Outcome, String> {
+    let context = |e: &dyn std::fmt::Display| format!("{}: {}", path.display(), e);
+    let checkpoint = checkpoint_path(path);
+    let resume_at = match read_checkpoint(&checkpoint).map_err(|e| context(&e))? {
+        Checkpoint::Complete => return Ok(Outcome::Skipped),
+        Checkpoint::Records(n) => n,
+    };
+    let mut retried = false;
+
+    let file = File::open(path).map_err(|e| context(&e))?;
+    let reader = Reader::new(BufReader::new(file)).map_err(|e| context(&e))?;
+
+    let mut chunk: Option<Chunk> = None;
+    for (index, record) in reader.enumerate().skip(resume_at as usize) {
+        let record = record.map_err(|e| context(&e))?;
+        let Some(decoded) = decode_record(&record) else {
+            counters.records_unsupported.fetch_add(1, Ordering::Relaxed);
+            continue;
+        };
+
+        let open = match chunk.as_mut() {
+            Some(open) => open,
+            None => chunk.insert(Chunk::open(new_stream, path, index).ok_or_else(|| {
+                context(&"failed to open upload stream")
+            })?),
+        };
+        open.push(&decoded);
+
+        if open.points >= CHECKPOINT_POINTS {
+            retried |= chunk.take().unwrap().close(counters);
+            write_checkpoint(&checkpoint, Checkpoint::Records(index as u64 + 1)).map_err(|e| context(&e))?;
+        }
+    }
+
+    if let Some(open) = chunk.take() {
+        retried |= open.close(counters);
+    }
+    write_checkpoint(&checkpoint, Checkpoint::Complete).map_err(|e| context(&e))?;
+    Ok(if retried { Outcome::Retried } else { Outcome::Uploaded })
+}
+
+/// Records sent through one upload stream between checkpoints
+struct Chunk {
+    // Keyed by channel name and sorted tags
+    writers: HashMap<String, WriterState>,
+    stream: Arc<NominalDatasetStream>,
+    retry: RetryFile,
+    records: u64,
+    points: u64,
+}
+
+impl Chunk {
+    fn open(new_stream: &StreamFactory, path: &Path, first_record: usize) -> Option<Self> {
+        let mut fallback = path.with_extension("").into_os_string();
+        fallback.push(format!(".retry-{}.avro", first_record));
+        let retry = RetryFile::new(PathBuf::from(fallback));
+        Some(Self {
+            writers: HashMap::new(),
+            stream: Arc::new(new_stream(&retry.path)?),
+            retry,
+            records: 0,
+            points: 0,
+        })
+    }
+
+    fn push(&mut self, record: &DecodedRecord) {
+        let mut tags = record.tags.clone();
+        tags.sort_unstable();
+        let mut key = record.channel.to_string();
+        for (k, v) in &tags {
+            key.push('\0');
+            key.push_str(k);
+            key.push('=');
+            key.push_str(v);
+        }
+        let stream = &self.stream;
+        let writer = self.writers.entry(key).or_insert_with(|| {
+            WriterState::new(Arc::clone(stream), Arc::new(descriptor(record.channel, &tags)))
+        });
+
+        for (timestamp, value) in record.timestamps.iter().zip(record.values) {
+            if let (Some(timestamp), Value::Double(value)) = (timestamp_ns(timestamp), unwrap_union(value)) {
+                writer.push(timestamp, *value);
+                self.points += 1;
+            }
+        }
+        self.records += 1;
+    }
+
+    /// Flush every writer and close the stream, which sends (or writes to the
+    /// retry file) everything it holds. Returns true if anything went to the
+    /// retry file.
+    fn close(self, counters: &Counters) -> bool {
+        drop(self.writers);
+        drop(self.stream);
+        let retried = self.retry.written();
+        let (records, points) = if retried {
+            (&counters.records_retried, &counters.points_retried)
+        } else {
+            (&counters.records_uploaded, &counters.points_uploaded)
+        };
+        records.fetch_add(self.records, Ordering::Relaxed);
+        points.fetch_add(self.points, Ordering::Relaxed);
+        retried
+    }
+}
+
+/// A chunk's retry file, and its length before the chunk's stream opened it.
+/// An interrupted run can leave one with the same name behind.
+struct RetryFile {
+    path: PathBuf,
+    len_before: u64,
+}
+
+impl RetryFile {
+    fn new(path: PathBuf) -> Self {
+        let len_before = fs::metadata(&path).map_or(0, |m| m.len());
+        Self { path, len_before }
+    }
+
+    /// Whether anything has been written to it since
+    fn written(&self) -> bool {
+        fs::metadata(&self.path).map_or(false, |m| m.len() > self.len_before)
+    }
+}
+
+/// One fallback file record: a channel, its tags and parallel point arrays
+struct DecodedRecord<'a> {
+    channel: &'a str,
+    tags: Vec<(&'a str, &'a str)>,
+    timestamps: &'a [Value],
+    values: &'a [Value],
+}
+
+fn decode_record(record: &Value) -> Option<DecodedRecord<'_>> {
+    let Value::Record(fields) = record else { return None };
+    let field = |name: &str| fields.iter().find(|(n, _)| n == name).map(|(_, v)| unwrap_union(v));
+
+    let Value::String(channel) = field("channel")? else { return None };
+    let timestamps = array_of(field("timestamps")?)?;
+    let values = array_of(field("values")?)?;
+    if !matches!(values.first().map(unwrap_union), Some(Value::Double(_)) | None) {
+        return None;
+    }
+    let tags = match field("tags") {
+        Some(Value::Map(tags)) => tags
+            .iter()
+            .filter_map(|(k, v)| match unwrap_union(v) {
+                Value::String(v) => Some((k.as_str(), v.as_str())),
+                _ => None,
+            })
+            .collect(),
+        _ => Vec::new(),
+    };
+
+    Some(DecodedRecord {
+        channel,
+        tags,
+        timestamps,
+        values,
+    })
+}
+
+fn unwrap_union(value: &Value) -> &Value {
+    match value {
+        Value::Union(_, inner) => unwrap_union(inner),
+        other => other,
+    }
+}
+
+/// An array, or a record wrapping a single array (typed array unions)
+fn array_of(value: &Value) -> Option<&[Value]> {
+    match value {
+        Value::Array(items) => Some(items),
+        Value::Record(fields) if fields.len() == 1 => array_of(unwrap_union(&fields[0].1)),
+        _ => None,
+    }
+}
+
+fn timestamp_ns(value: &Value) -> Option<u64> {
+    let ns = match unwrap_union(value) {
+        Value::Long(t) | Value::TimestampNanos(t) => *t,
+        Value::TimestampMicros(t) => t.checked_mul(1_000)?,
+        Value::TimestampMillis(t) => t.checked_mul(1_000_000)?,
+        Value::Int(t) => *t as i64,
+        _ => return None,
+    };
+    u64::try_from(ns).ok()
+}
+
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+enum Checkpoint {
+    /// Records before this index have been sent
+    Records(u64),
+    Complete,
+}
+
+fn checkpoint_path(path: &Path) -> PathBuf {
+    let mut name = OsString::from(path.as_os_str());
+    name.push(".progress");
+    PathBuf::from(name)
+}
+
+fn read_checkpoint(path: &Path) -> io::Result<Checkpoint> {
+    let text = match fs::read_to_string(path) {
+        Ok(t) => t,
+        Err(e) if e.kind() == ErrorKind::NotFound => return Ok(Checkpoint::Records(0)),
+        Err(e) => return Err(e),
+    };
+    let text = text.trim();
+    if text == "complete" {
+        return Ok(Checkpoint::Complete);
+    }
+    text.strip_prefix("records ")
+        .and_then(|n| n.parse().ok())
+        .map(Checkpoint::Records)
+        .ok_or_else(|| io::Error::new(ErrorKind::InvalidData, "unreadable upload checkpoint"))
+}
+
+/// Replace the checkpoint atomically, so a crash leaves the old or new one
+fn write_checkpoint(path: &Path, checkpoint: Checkpoint) -> io::Result<()> {
+    let text = match checkpoint {
+        Checkpoint::Records(n) => format!("records {}\n", n),
+        Checkpoint::Complete => "complete\n".to_string(),
+    };
+    let mut temp = OsString::from(path.as_os_str());
+    temp.push(".tmp");
+    fs::write(&temp, text)?;
+    fs::rename(&temp, path)
+}
+
+/// Files matching `pattern`, sorted. `*` and `?` are supported in the file
+/// name only, e.g. `C:\data\fallback\*.avro`. Such a pattern also matches
+/// `.retry-<record>.avro` files from earlier uploads and `.spill.avro` files
+/// from backpressure, so those are picked up on the next run.
+pub(crate) fn glob(pattern: &str) -> io::Result<Vec<PathBuf>> {
+    let pattern = Path::new(pattern);
+    let dir = match pattern.parent() {
+        Some(dir) if !dir.as_os_str().is_empty() => dir,
+        _ => Path::new("."),
+    };
+    if dir.to_string_lossy().contains(['*', '?']) {
+        return Err(io::Error::new(
+            ErrorKind::InvalidInput,
+            "wildcards are only supported in the file name",
+        ));
+    }
+    let name_pattern = pattern
+        .file_name()
+        .and_then(|name| name.to_str())
+        .ok_or_else(|| io::Error::new(ErrorKind::InvalidInput, "pattern has no file name"))?;
+
+    let mut matches: Vec<PathBuf> = fs::read_dir(dir)?
+        .filter_map(|entry| entry.ok())
+        .filter(|entry| entry.file_type().map_or(false, |t| t.is_file()))
+        .filter(|entry| entry.file_name().to_str().map_or(false, |name| wildcard_match(name_pattern, name)))
+        .map(|entry| entry.path())
+        .collect();
+    matches.sort();
+    Ok(matches)
+}
+
+fn wildcard_match(pattern: &str, name: &str) -> bool {
+    let pattern: Vec<char> = pattern.chars().collect();
+    let name: Vec<char> = name.chars().collect();
+    let (mut p, mut n) = (0, 0);
+    // Position of the last `*` and the name index it matched up to
+    let mut star: Option<(usize, usize)> = None;
+    while n < name.len() {
+        if p < pattern.len() && (pattern[p] == '?' || pattern[p] == name[n]) {
+            p += 1;
+            n += 1;
+        } else if p < pattern.len() && pattern[p] == '*' {
+            star = Some((p, n));
+            p += 1;
+        } else if let Some((star_p, star_n)) = star {
+            p = star_p + 1;
+            n = star_n + 1;
+            star = Some((star_p, star_n + 1));
+        } else {
+            return false;
+        }
+    }
+    pattern[p..].iter().all(|&c| c == '*')
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_wildcard_match() {
+        assert!(wildcard_match("*.avro", "run.avro"));
+        assert!(wildcard_match("run_??.avro", "run_01.avro"));
+        assert!(wildcard_match("*_*.avro", "a_b_c.avro"));
+        assert!(!wildcard_match("*.avro", "run.avro.progress"));
+        assert!(!wildcard_match("run_?.avro", "run_01.avro"));
+    }
+
+    #[test]
+    fn test_glob() {
+        let dir = std::env::temp_dir().join("nominal_ffi_test_glob");
+        let _ = fs::remove_dir_all(&dir);
+        fs::create_dir_all(&dir).unwrap();
+        for name in ["b.avro", "a.avro", "a.avro.progress", "notes.txt"] {
+            fs::write(dir.join(name), b"").unwrap();
+        }
+        let files = glob(dir.join("*.avro").to_str().unwrap()).unwrap();
+        assert_eq!(files, vec![dir.join("a.avro"), dir.join("b.avro")]);
+        assert!(glob(dir.join("*").join("*.avro").to_str().unwrap()).is_err());
+        fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_retry_file_written() {
+        let dir = std::env::temp_dir().join("nominal_ffi_test_retry_file");
+        let _ = fs::remove_dir_all(&dir);
+        fs::create_dir_all(&dir).unwrap();
+        let path = dir.join("run.retry-0.avro");
+
+        let retry = RetryFile::new(path.clone());
+        assert!(!retry.written());
+        fs::write(&path, b"").unwrap();
+        assert!(!retry.written());
+        fs::write(&path, b"Obj").unwrap();
+        assert!(retry.written());
+
+        // Left by an earlier run: only growth counts
+        let retry = RetryFile::new(path.clone());
+        assert!(!retry.written());
+        fs::write(&path, b"Obj1").unwrap();
+        assert!(retry.written());
+        fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_checkpoint_roundtrip() {
+        let dir = std::env::temp_dir().join("nominal_ffi_test_checkpoint");
+        fs::create_dir_all(&dir).unwrap();
+        let path = checkpoint_path(&dir.join("run.avro"));
+        let _ = fs::remove_file(&path);
+
+        assert_eq!(read_checkpoint(&path).unwrap(), Checkpoint::Records(0));
+        write_checkpoint(&path, Checkpoint::Records(42)).unwrap();
+        assert_eq!(read_checkpoint(&path).unwrap(), Checkpoint::Records(42));
+        write_checkpoint(&path, Checkpoint::Complete).unwrap();
+        assert_eq!(read_checkpoint(&path).unwrap(), Checkpoint::Complete);
+        fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_decode_record() {
+        let record = Value::Record(vec![
+            ("channel".to_string(), Value::String("temp".to_string())),
+            ("timestamps".to_string(), Value::Array(vec![Value::Long(1), Value::Long(2)])),
+            (
+                "values".to_string(),
+                Value::Union(0, Box::new(Value::Array(vec![Value::Double(0.5), Value::Double(1.5)]))),
+            ),
+            (
+                "tags".to_string(),
+                Value::Map([("rig".to_string(), Value::String("3".to_string()))].into_iter().collect()),
+            ),
+        ]);
+        let decoded = decode_record(&record).unwrap();
+        assert_eq!(decoded.channel, "temp");
+        assert_eq!(decoded.tags, vec![("rig", "3")]);
+        assert_eq!(decoded.timestamps.len(), 2);
+        assert_eq!(timestamp_ns(&decoded.timestamps[1]), Some(2));
+
+        let strings = Value::Record(vec![
+            ("channel".to_string(), Value::String("state".to_string())),
+            ("timestamps".to_string(), Value::Array(vec![Value::Long(1)])),
+            ("values".to_string(), Value::Array(vec![Value::String("on".to_string())])),
+        ]);
+        assert!(decode_record(&strings).is_none());
+    }
+}